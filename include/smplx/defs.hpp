@@ -14,6 +14,9 @@
 
 #include <Eigen/Core>
 #include <Eigen/Sparse>
+#include <map>
+#include <string>
+#include <vector>
 
 namespace smplx {
 
@@ -36,6 +39,7 @@ using Vector = Eigen::Matrix<Scalar, Eigen::Dynamic, 1>;
 using MatrixColMajor = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic, Eigen::ColMajor>;
 
 using Triangles = Eigen::Matrix<Index, Eigen::Dynamic, 3, Eigen::RowMajor>;
+using IndexVector = Eigen::Matrix<Index, Eigen::Dynamic, 1>;
 
 using SparseMatrixColMajor = Eigen::SparseMatrix<Scalar>;
 using SparseMatrix = Eigen::SparseMatrix<Scalar, Eigen::RowMajor>;
@@ -44,5 +48,94 @@ enum class Gender {
     unknown, neutral, male, female
 };
 
+// Compute backend used by Body::update,
+// selectable per Model (Model::set_backend) or per Body (Body::set_backend)
+enum class Backend {
+    // For Body: use the model's backend.
+    // For Model: CUDA if available, else cpu_simd
+    automatic,
+    // Plain Eigen implementation, single-threaded; the reference
+    // all other backends should match
+    cpu_reference,
+    // Runtime-dispatched SIMD kernels, single-threaded
+    cpu_simd,
+    // Runtime-dispatched SIMD kernels, split across ThreadPool::global()
+    cpu_parallel,
+    // CUDA, only available if built with CUDA
+    cuda,
+};
+
+// Model data loaded on first use when the model is loaded from .npz (see
+// Model::require); other data is loaded with the model
+enum class ModelComponent {
+    // Model::blend_shapes shape columns and Model::joint_shape_blends
+    shape_blends,
+    // Model::blend_shapes pose columns
+    pose_blends,
+    // Model::hand_mean_l/r, hand_comps_l/r
+    hand_pca,
+    // Model::uv, uv_faces, uv_to_vert
+    uv_map,
+    // Model::face_verts, face_blend_shapes
+    face_region,
+};
+
+// Page backing of the large arrays of a model (see Model::set_huge_pages)
+enum class HugePages {
+    // Normal pages
+    off,
+    // Transparent huge pages (Linux madvise), if enabled in the system
+    transparent,
+    // Explicit huge pages reserved by the system (Linux MAP_HUGETLB,
+    // vm.nr_hugepages), else transparent
+    reserved,
+};
+
+// Approximate host memory of an object by part, in bytes (see
+// Model::memory_usage, Body::memory_usage)
+struct MemoryUsage {
+    std::map<std::string, size_t> parts;
+
+    inline size_t total() const {
+        size_t sum = 0;
+        for (const auto& part : parts) sum += part.second;
+        return sum;
+    }
+};
+
+// Frame of sparse vertex displacements (see Body::set_displacements)
+enum class DisplacementSpace {
+    // Rest pose, before skinning: moved with the vertex transform
+    canonical,
+    // Posed (world) space, after skinning
+    posed,
+};
+
+// A decimated version of a model mesh (see Model::add_lod): a subset of the
+// model vertices with its own triangles. Blend shapes and weights are the
+// rows of the model's at those vertices, and joints are those of the full
+// mesh, so a body evaluated at a LOD matches the full body at the kept
+// vertices.
+struct LevelOfDetail {
+    // Model vertex of each LOD vertex, (#LOD verts)
+    std::vector<Index> vert_ids;
+    // Triangles in LOD vertex indices, (#LOD faces, 3)
+    Triangles faces;
+    // Vertex-face adjacency, (#LOD verts, #LOD faces) CSR
+    SparseMatrix vert_faces;
+    // Rows of Model::verts, (#LOD verts, 3)
+    Points verts;
+    // Rows of Model::blend_shapes, (3*#LOD verts, #blend shapes)
+    MatrixColMajor blend_shapes;
+    // Rows of Model::weights, (#LOD verts, #joints) CSR
+    SparseMatrix weights;
+    // Template joints of the full mesh, Model::joint_reg * Model::verts,
+    // (#joints, 3)
+    Points joints;
+
+    inline size_t n_verts() const { return vert_ids.size(); }
+    inline size_t n_faces() const { return faces.rows(); }
+};
+
 }
 #endif  // ifndef SMPL_COMMON_4E758201_E767_4C0C_9E87_0F1A988E0FE1
@@ -0,0 +1,136 @@
+#pragma once
+#ifndef SMPLX_INTERNAL_BACKEND_F3B78EAA_6923_46E2_AECB_55D01BC8BC49
+#define SMPLX_INTERNAL_BACKEND_F3B78EAA_6923_46E2_AECB_55D01BC8BC49
+
+#include <memory>
+
+#include "smplx/defs.hpp"
+
+namespace smplx {
+
+template <class ModelConfig>
+class Model;
+class PoseCache;
+
+namespace internal {
+
+using Transforms = Eigen::Matrix<Scalar, Eigen::Dynamic, 12, Eigen::RowMajor>;
+
+// Outputs of Body::update; see the Body accessors for details
+struct BodyOutputs {
+    // Vertices with shape (and pose blend shapes) applied, (#verts, 3)
+    Points verts_shaped;
+    // Vertices with shape and pose applied, (#verts, 3)
+    Points verts;
+    // Joints with only shape applied, (#joints, 3)
+    Points joints_shaped;
+    // Joints with shape and pose applied, (#joints, 3)
+    Points joints;
+    // Joint transforms, (#joints, 12), row-major 3x4 each
+    Transforms joint_transforms;
+    // Vertex transforms, (#verts, 12); a backend may instead resize this to
+    // 0 rows, in which case Body computes it on demand
+    Transforms vert_transforms;
+    // Level of detail of the vertex outputs (see Model::add_lod); #verts
+    // above is that of the level. 0 = full mesh
+    size_t lod = 0;
+    // Data of the level, kept alive with the outputs; null for level 0
+    std::shared_ptr<const LevelOfDetail> lod_data;
+};
+
+/** Per-Body state of a compute backend (e.g. device buffers),
+ *  created by ModelBackend::create_body */
+template <class ModelConfig>
+class BodyBackend {
+   public:
+    virtual ~BodyBackend() = default;
+
+    // Compute all outputs from parameters:
+    // full_pose: angle-axis pose of all joints, including hands (3*#joints)
+    // shape: shape params (#shape blends), trans: root translation
+    // template_offsets: added to model.verts, (#verts, 3); nullptr = none
+    // (see Body::set_template_offsets)
+    // Outputs may be left on the device until retrieve_*() is called.
+    virtual void update(const Vector& full_pose,
+                        const Eigen::Ref<const Vector>& shape,
+                        const Eigen::Ref<const Vector3f>& trans,
+                        const Points* template_offsets,
+                        bool enable_pose_blendshapes, BodyOutputs& out) = 0;
+
+    // Make out.verts/out.verts_shaped of the last update available in host
+    // memory; no-op for CPU backends
+    virtual void retrieve_verts(BodyOutputs& out) {}
+    virtual void retrieve_verts_shaped(BodyOutputs& out) {}
+};
+
+/** Per-Model state of a compute backend: owns the backend's copy or layout
+ *  of model data (if any) and creates per-Body states.
+ *  Created on first use by Model::backend_data. */
+template <class ModelConfig>
+class ModelBackend {
+   public:
+    explicit ModelBackend(const Model<ModelConfig>& model) : model(model) {}
+    virtual ~ModelBackend() = default;
+
+    // Backend type
+    virtual Backend type() const = 0;
+
+    // Called after Model::load replaced the model data
+    virtual void model_loaded() {}
+    // Called after the model template (Model::verts) changed
+    virtual void template_changed() {}
+
+    // Create state for a new body of this model
+    virtual std::unique_ptr<BodyBackend<ModelConfig>> create_body() const = 0;
+
+    const Model<ModelConfig>& model;
+};
+
+// Create backend state for model; nullptr if backend is not available in
+// this build. backend must not be automatic.
+template <class ModelConfig>
+std::unique_ptr<ModelBackend<ModelConfig>> create_model_backend(
+    const Model<ModelConfig>& model, Backend backend);
+
+// CUDA backend factory, defined only in CUDA builds (src/cuda/backend.cu)
+template <class ModelConfig>
+std::unique_ptr<ModelBackend<ModelConfig>> create_cuda_model_backend(
+    const Model<ModelConfig>& model);
+
+// Resolve automatic backend choices: body's choice, else model's, else
+// the default for this build
+Backend resolve_backend(Backend body_backend, Backend model_backend);
+
+// Evaluate level of detail level >= 1 of the model, with data lod (see
+// Model::add_lod), on the CPU, with arguments as BodyBackend::update; used
+// by Body for any backend
+template <class ModelConfig>
+void update_lod(const Model<ModelConfig>& model, size_t level,
+                const std::shared_ptr<const LevelOfDetail>& lod,
+                const Vector& full_pose, const Eigen::Ref<const Vector>& shape,
+                const Eigen::Ref<const Vector3f>& trans,
+                const Points* template_offsets, bool enable_pose_blendshapes,
+                BodyOutputs& out);
+
+// Evaluate the full mesh on the CPU taking the pose blend shape offsets
+// from cache, computing and inserting them on a miss; arguments as
+// BodyBackend::update. parallel: split across ThreadPool::global()
+template <class ModelConfig>
+void update_pose_cached(const Model<ModelConfig>& model, PoseCache& cache,
+                        bool parallel, const Vector& full_pose,
+                        const Eigen::Ref<const Vector>& shape,
+                        const Eigen::Ref<const Vector3f>& trans,
+                        const Points* template_offsets, BodyOutputs& out);
+
+// Complete the joint transforms; shared by all backends
+// Inputs: trans, out.joints_shaped,
+//         local joint rotations in left 3x3 of out.joint_transforms
+// Outputs: out.joints, out.joint_transforms (rel. global)
+template <class ModelConfig>
+void local_to_global(const Eigen::Ref<const Vector3f>& trans,
+                     BodyOutputs& out);
+
+}  // namespace internal
+}  // namespace smplx
+
+#endif  // ifndef SMPLX_INTERNAL_BACKEND_F3B78EAA_6923_46E2_AECB_55D01BC8BC49
@@ -0,0 +1,61 @@
+#pragma once
+#ifndef SMPLX_INTERNAL_CPU_KERNELS_5D8D1375_9B1A_497B_A747_534D0F5510C7
+#define SMPLX_INTERNAL_CPU_KERNELS_5D8D1375_9B1A_497B_A747_534D0F5510C7
+
+// Hot CPU kernels on raw float arrays. Each instruction set variant is
+// compiled separately (src/kernels/kernels_*.cpp) and the best one supported
+// by the CPU is picked at runtime, so this header must stay free of Eigen.
+#include <cstddef>
+#include <cstdint>
+
+namespace smplx {
+namespace internal {
+
+struct CpuKernels {
+    // Variant name: scalar, avx2 or avx512
+    const char* name;
+
+    // Blend shape GEMV: y[r] += sum_k a[k * lda + r] * x[k]
+    // for r in [row_begin, row_end); a is column-major with n_cols columns
+    void (*gemv)(const float* a, size_t lda, const float* x, float* y,
+                 size_t n_cols, size_t row_begin, size_t row_end);
+
+    // Batch Rodrigues: angle-axis aa (n, 3) -> rotation matrices written to
+    // the left 3x3 block of each row-major (3, 4) transform in out (n, 12)
+    void (*rodrigues)(const float* aa, float* out, size_t n);
+
+    // Linear blend skinning for vertices [begin, end):
+    // LBS weights in CSR (outer, inner, values), joint transforms (#joints,
+    // 12) row-major 3x4, verts_in/verts_out (#verts, 3).
+    // Also writes the (#verts, 12) vertex transforms if vert_transforms
+    // is not null
+    void (*lbs)(const int* w_outer, const int* w_inner, const float* w_values,
+                const float* joint_transforms, const float* verts_in,
+                float* verts_out, float* vert_transforms, size_t begin,
+                size_t end);
+
+    // Unnormalized normals (#faces, 3) of faces [begin, end)
+    void (*face_normals)(const float* verts, const uint32_t* faces,
+                         float* face_normals, size_t begin, size_t end);
+
+    // Unit normals (#verts, 3) of vertices [begin, end), gathered from face
+    // normals through the vertex-face adjacency in CSR (outer, inner)
+    void (*vert_normals)(const int* vf_outer, const int* vf_inner,
+                         const float* face_normals, float* normals,
+                         size_t begin, size_t end);
+};
+
+// Kernels for the best instruction set supported by this CPU, chosen on
+// first call. Set the environment variable SMPLX_CPU_ISA to scalar, avx2 or
+// avx512 to force a variant (e.g. for testing).
+const CpuKernels& cpu_kernels();
+
+// Per-variant kernel tables; nullptr if the variant was not compiled
+const CpuKernels* cpu_kernels_scalar();
+const CpuKernels* cpu_kernels_avx2();
+const CpuKernels* cpu_kernels_avx512();
+
+}  // namespace internal
+}  // namespace smplx
+
+#endif  // ifndef SMPLX_INTERNAL_CPU_KERNELS_5D8D1375_9B1A_497B_A747_534D0F5510C7
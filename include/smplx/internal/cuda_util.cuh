@@ -6,6 +6,15 @@
 #define RESTRICT __restrict__
 #endif
 namespace smplx {
+namespace internal {
+// Basic CSR sparse matrix repr
+struct GPUSparseMatrix {
+    float* values = nullptr;
+    int* inner = nullptr;
+    int* outer = nullptr;
+    int rows, cols, nnz;
+};
+}  // namespace internal
 
 #define cudaCheck(func)                                               \
     {                                                                  \
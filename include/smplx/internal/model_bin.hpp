@@ -0,0 +1,156 @@
+#pragma once
+#ifndef SMPLX_INTERNAL_MODEL_BIN_32EE3F48_D9CD_400D_BDA3_ED1EC7CD656A
+#define SMPLX_INTERNAL_MODEL_BIN_32EE3F48_D9CD_400D_BDA3_ED1EC7CD656A
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "smplx/defs.hpp"
+
+namespace smplx {
+namespace internal {
+
+/** Read-only bytes of a model image: a memory-mapped file, or any other
+ *  buffer kept alive by owner */
+struct BinaryImage {
+    const char* data = nullptr;
+    size_t size = 0;
+    std::shared_ptr<const void> owner;
+};
+
+// Memory-map the file at path read-only (pages are read on first access);
+// throws std::runtime_error on failure
+BinaryImage map_file(const std::string& path);
+
+// Zeroed, page-aligned memory of size bytes (nullptr if 0), backed by huge
+// pages as mode asks where the system allows, else by normal pages; freed
+// with the last owner. Throws std::bad_alloc on failure.
+std::shared_ptr<void> allocate_pages(size_t size, HugePages mode);
+// Read each page of [data, data + size), so none faults later, and if lock
+// pin them in RAM; returns false if they could not be locked
+bool prefault_pages(const void* data, size_t size, bool lock);
+// Unpin the pages of [data, data + size) locked by prefault_pages
+void unlock_pages(const void* data, size_t size);
+
+// Named shared memory segments holding a model image, after a control
+// block with the generation and attach count (POSIX only)
+struct SharedImageInfo {
+    // 1 for the first publish under the name, then incremented by each
+    // publish replacing the segment
+    uint64_t generation;
+    // Images currently attached (see attach_shared_image), across
+    // processes; not decremented for processes which crashed, and not
+    // counting read-only attaches
+    uint32_t n_attached;
+    // Image size in bytes
+    uint64_t size;
+};
+
+// Create segment name of an image of size bytes, replacing any segment of
+// that name, and fill the image with write(image). Attachers only see it
+// once complete. Throws std::runtime_error on failure.
+void publish_shared_image(const std::string& name, uint64_t size,
+                          const std::function<void(char*)>& write);
+// Map the image of segment name read-only, counting the attach until the
+// image is released. The segment is only writable by the publisher's
+// user: other users attach read-only, uncounted. If counted is not null,
+// sets it to whether this attach is counted. Throws std::runtime_error on
+// failure.
+BinaryImage attach_shared_image(const std::string& name,
+                                bool* counted = nullptr);
+// Remove segment name; false if it did not exist
+bool unlink_shared_image(const std::string& name);
+// Info of segment name; throws std::runtime_error if it does not exist
+SharedImageInfo shared_image_info(const std::string& name);
+
+// Image compiled into the library (see SMPLX_EMBED_MODELS in
+// CMakeLists.txt) by name, its file name without extension, e.g.
+// "SMPLX_NEUTRAL"; never freed. Throws std::invalid_argument if there is
+// no image of that name.
+BinaryImage embedded_image(const std::string& name);
+// Names of the images compiled into the library
+std::vector<std::string> embedded_image_names();
+
+/** .smplxbin model format, written by Model::save_binary.
+ *  A Header followed by sections, each starting at a multiple of ALIGN
+ *  bytes, in the in-memory layout of the Model members they load into
+ *  (host byte order), so blend shapes are used in place and the rest is
+ *  loaded with one copy per section. */
+namespace smplxbin {
+
+const char MAGIC[8] = {'S', 'M', 'P', 'L', 'X', 'B', 'I', 'N'};
+const uint32_t VERSION = 2;
+const size_t ALIGN = 64;
+
+enum Section : uint32_t {
+    // (#verts, 3) float, row-major
+    verts,
+    // (#faces, 3) uint32, row-major
+    faces,
+    // Joint regressor (#joints, #verts) CSR: outer (#joints + 1) int32,
+    // inner (nnz) int32, values (nnz) float
+    joint_reg_outer,
+    joint_reg_inner,
+    joint_reg_values,
+    // LBS weights (#verts, #joints) CSR, as the joint regressor
+    weights_outer,
+    weights_inner,
+    weights_values,
+    // (3*#verts, #shape blends + #pose blends) float, column-major
+    blend_shapes,
+    // (3*#joints, #shape blends) float, column-major
+    joint_shape_blends,
+    // Hand PCA (optional): means (#hand params) float,
+    // components (#hand params, #hand pca) float, row-major
+    hand_mean_l,
+    hand_mean_r,
+    hand_comps_l,
+    hand_comps_r,
+    // UV map (optional): (#uv verts, 2) float, row-major;
+    // (#faces, 3) uint32, row-major
+    uv,
+    uv_faces,
+    n_sections
+};
+
+struct SectionEntry {
+    // In bytes from the start of the file; size 0 = absent
+    uint64_t offset, size;
+};
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    // smplx::Gender
+    uint32_t gender;
+    // ModelConfig::model_name the data was saved from
+    char model_name[32];
+    uint64_t n_verts, n_faces, n_joints, n_shape_blends, n_pose_blends;
+    uint64_t n_hand_params, n_hand_pca, n_uv_verts;
+    // Of the n_shape_blends, which may be fewer than the ModelConfig's
+    // (see Model::set_shape_space)
+    uint64_t n_expression_blends;
+    SectionEntry sections[n_sections];
+};
+
+// True if the file at path starts with MAGIC
+bool is_smplxbin(const std::string& path);
+
+// Write the image with header and sections data (see Header::sections)
+// to out, which must hold the image size
+void write_image(const Header& header, const void* const data[n_sections],
+                 char* out);
+
+// Round offset up to a multiple of ALIGN
+inline uint64_t align(uint64_t offset) {
+    return (offset + ALIGN - 1) / ALIGN * ALIGN;
+}
+
+}  // namespace smplxbin
+}  // namespace internal
+}  // namespace smplx
+
+#endif  // ifndef SMPLX_INTERNAL_MODEL_BIN_32EE3F48_D9CD_400D_BDA3_ED1EC7CD656A
@@ -0,0 +1,124 @@
+#pragma once
+#ifndef SMPLX_INTERNAL_NPZ_757FEF4C_1F60_42C4_8DD7_856745981B83
+#define SMPLX_INTERNAL_NPZ_757FEF4C_1F60_42C4_8DD7_856745981B83
+
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <initializer_list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cnpy.h>
+
+#include "smplx/defs.hpp"
+
+namespace smplx {
+namespace internal {
+
+/** Random-access .npz reader: the zip central directory is read on open,
+ *  so each array is read (and inflated) without touching the others.
+ *  Arrays are inflated in chunks and handed over as they come, so they can
+ *  be converted straight into their final storage (see load_into).
+ *  The file is kept open, so arrays loaded later come from the same file
+ *  even if it is replaced on disk. Thread-safe: arrays loaded from several
+ *  threads are inflated concurrently (see run_concurrently). */
+class NpzReader {
+   public:
+    // .npy array header
+    struct ArrayHeader {
+        std::vector<size_t> shape;
+        // dtype kind: 'f' float, 'i' signed int, 'u' unsigned int, 'b' bool,
+        // 'S' bytes, 'U' unicode (UTF-32)...
+        char kind;
+        // Bytes per value
+        size_t word_size;
+        bool fortran_order;
+
+        size_t n_values() const;
+    };
+
+    // Throws std::runtime_error if path cannot be opened or is not a zip
+    explicit NpzReader(const std::string& path);
+
+    NpzReader(const NpzReader&) = delete;
+    NpzReader& operator=(const NpzReader&) = delete;
+
+    // True if the archive has array name (without .npy)
+    inline bool contains(const std::string& name) const {
+        return _members.count(name) > 0;
+    }
+
+    // Read array name in one pass: on_header(header), then
+    // on_data(values, first, count) for consecutive runs of raw
+    // little-endian values, first being the index of the first in storage
+    // order. Throws std::runtime_error if the array is missing or corrupt,
+    // and passes on exceptions of the callbacks.
+    void stream(const std::string& name,
+                const std::function<void(const ArrayHeader&)>& on_header,
+                const std::function<void(const char* values, size_t first,
+                                         size_t count)>& on_data) const;
+
+    // Load array name, which must have the given shape, as a (rows, cols)
+    // matrix with cols the last dimension (rows, 1 if 1D), converting each
+    // value as it is inflated: element (i, j) is stored at
+    // out[i * row_stride + j * col_stride]. Throws std::runtime_error on
+    // a shape mismatch or non-numeric dtype.
+    void load_into(const std::string& name,
+                   std::initializer_list<size_t> shape, Scalar* out,
+                   size_t row_stride, size_t col_stride) const;
+    void load_into(const std::string& name,
+                   std::initializer_list<size_t> shape, Index* out,
+                   size_t row_stride, size_t col_stride) const;
+    // As load_into, but column j is stored at column col_map[j] of out, or
+    // skipped if col_map[j] < 0, e.g. to keep some of the columns only
+    void load_cols_into(const std::string& name,
+                        std::initializer_list<size_t> shape,
+                        const std::vector<int>& col_map, Scalar* out,
+                        size_t row_stride, size_t col_stride) const;
+    // Load 2D array name, which must have the given shape, as a sparse
+    // matrix of its nonzeros, without a dense copy
+    void load_sparse(const std::string& name,
+                     std::initializer_list<size_t> shape,
+                     SparseMatrix& out) const;
+
+    // Load array name whole (cnpy layout)
+    cnpy::NpyArray load(const std::string& name) const;
+    // Load the arrays of names the archive contains, concurrently
+    std::map<std::string, cnpy::NpyArray> load_all(
+        const std::vector<std::string>& names) const;
+
+    // Run tasks, e.g. loads of different arrays, concurrently on
+    // ThreadPool::global() and the calling thread. Once all are done,
+    // rethrows the exception of the first task which threw, if any.
+    static void run_concurrently(
+        const std::vector<std::function<void()>>& tasks);
+
+    inline const std::string& path() const { return _path; }
+
+   private:
+    struct Member {
+        // Of the local header
+        uint64_t offset;
+        uint64_t compressed_size, size;
+        // 0 = stored, 8 = deflate
+        uint16_t method;
+    };
+
+    // Call f(i, j, value) for each element of array name, which must have
+    // shape, converted to T, viewed as in load_into
+    template <class T, class Func>
+    void _for_each(const std::string& name,
+                   std::initializer_list<size_t> shape, Func f) const;
+
+    std::string _path;
+    std::map<std::string, Member> _members;
+    mutable std::ifstream _file;
+    mutable std::mutex _mtx;
+};
+
+}  // namespace internal
+}  // namespace smplx
+
+#endif  // ifndef SMPLX_INTERNAL_NPZ_757FEF4C_1F60_42C4_8DD7_856745981B83
@@ -37,8 +37,7 @@ template <class SequenceConfig>
 struct SequenceModelSpec<SequenceConfig, model_config::SMPL> {
     static void set_shape(const Sequence<SequenceConfig>& seq,
                           Body<model_config::SMPL>& body) {
-        body.shape().noalias() =
-            seq.shape.template head<model_config::SMPL::n_shape_blends()>();
+        body.shape().noalias() = seq.shape.head(body.shape().size());
     }
     static void set_pose(const Sequence<SequenceConfig>& seq,
                          Body<model_config::SMPL>& body, size_t frame) {
@@ -54,7 +53,7 @@ template <class SequenceConfig>
 struct SequenceModelSpec<SequenceConfig, model_config::SMPLH> {
     static void set_shape(const Sequence<SequenceConfig>& seq,
                           Body<model_config::SMPLH>& body) {
-        body.shape().noalias() = seq.shape;
+        body.shape().noalias() = seq.shape.head(body.shape().size());
     }
     static void set_pose(const Sequence<SequenceConfig>& seq,
                          Body<model_config::SMPLH>& body, size_t frame) {
@@ -0,0 +1,27 @@
+#pragma once
+#ifndef SMPLX_INTERNAL_SHARED_ARRAY_0C26E7E0_8E8E_4DC8_9C80_36B0E9EC4010
+#define SMPLX_INTERNAL_SHARED_ARRAY_0C26E7E0_8E8E_4DC8_9C80_36B0E9EC4010
+
+#include <memory>
+
+#include "smplx/defs.hpp"
+
+namespace smplx {
+namespace internal {
+
+/** Process-wide table of immutable model arrays keyed by content, so models
+ *  with identical arrays (e.g. the faces of each gender of a model) share
+ *  one copy. An array is freed once no model uses it. Thread-safe.
+ *  Host arrays only: backend copies of model data (e.g. the CUDA device
+ *  arrays) are made per model and not deduplicated. */
+
+// Shared array equal to value: one already in use if any, else value.
+// Instantiated for Triangles, Points2D, IndexVector and SparseMatrix
+// (compressed first).
+template <class T>
+std::shared_ptr<const T> share_array(T&& value);
+
+}  // namespace internal
+}  // namespace smplx
+
+#endif  // ifndef SMPLX_INTERNAL_SHARED_ARRAY_0C26E7E0_8E8E_4DC8_9C80_36B0E9EC4010
@@ -0,0 +1,58 @@
+#pragma once
+#ifndef SMPLX_INTERNAL_UV_MAP_597A63A7_558E_4EC1_89E1_29A20F4AC9A8
+#define SMPLX_INTERNAL_UV_MAP_597A63A7_558E_4EC1_89E1_29A20F4AC9A8
+
+#include <cstdint>
+#include <string>
+
+#include "smplx/defs.hpp"
+
+namespace smplx {
+namespace internal {
+
+/** UV map files. The text format (data/models/smplx/uv.txt) holds the
+ *  number of UV vertices, their coordinates (u v each) and one UV triangle
+ *  per mesh face (1-based indices). It is parsed once and cached next to
+ *  it in the binary format below, which loads with one read while the
+ *  text file is unchanged. */
+namespace uvbin {
+
+const char MAGIC[8] = {'S', 'M', 'P', 'L', 'X', 'U', 'V', '\0'};
+const uint32_t VERSION = 1;
+
+// Followed by the UV coordinates, (#uv verts, 2) float, row-major, and the
+// UV triangles, (#faces, 3) uint32 0-based, row-major (host byte order)
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t n_uv_verts;
+    uint64_t n_faces;
+    // Of the text file the cache was made from, to detect it changed;
+    // mtime in ns where the system has it, else in s
+    uint64_t source_size;
+    int64_t source_mtime;
+};
+
+}  // namespace uvbin
+
+// Path of the binary cache of the text UV map at path: path with its
+// extension replaced by .smplxuv
+std::string uv_cache_path(const std::string& path);
+
+// Parse the text UV map at path, with n_faces triangles, in one pass over
+// the file read whole. Throws std::runtime_error if it cannot be read or
+// is malformed.
+void parse_uv_text(const std::string& path, size_t n_faces, Points2D& uv,
+                   Triangles& uv_faces);
+
+// Load the UV map at path, with n_faces triangles, from its cache (see
+// uv_cache_path) if up to date, else parse it and write the cache; a cache
+// which cannot be written, e.g. in a read-only directory, is skipped.
+// Throws as parse_uv_text.
+void load_uv_map(const std::string& path, size_t n_faces, Points2D& uv,
+                 Triangles& uv_faces);
+
+}  // namespace internal
+}  // namespace smplx
+
+#endif  // ifndef SMPLX_INTERNAL_UV_MAP_597A63A7_558E_4EC1_89E1_29A20F4AC9A8
@@ -13,6 +13,8 @@ struct ModelConfigBase {
     static constexpr size_t n_joints() {
         return Derived::n_explicit_joints() + Derived::n_hand_pca_joints() * 2;
     }
+    // Of the full model data; a Model may keep fewer shape blend shapes
+    // (see Model::set_shape_space)
     static constexpr size_t n_params() {
         return 3 + Derived::n_explicit_joints() * 3 +
                Derived::n_hand_pca() * 2 + Derived::n_shape_blends();
@@ -23,6 +25,11 @@ struct ModelConfigBase {
     }
     static constexpr size_t n_hand_pca_joints() { return 0; }
     static constexpr size_t n_hand_pca() { return 0; }
+    // Expression blend shapes: the last n_expression_blends() shape blends
+    static constexpr size_t n_expression_blends() { return 0; }
+    // Face joints (jaw, eyes): n_face_joints() joints from face_joint_begin()
+    static constexpr size_t face_joint_begin() { return 0; }
+    static constexpr size_t n_face_joints() { return 0; }
 };
 
 template <class Derived>
@@ -89,6 +96,8 @@ struct SMPLXBase : public internal::ModelConfigBase<Derived> {
                                                  "right_thumb1",
                                                  "right_thumb2",
                                                  "right_thumb3"};
+    static constexpr size_t face_joint_begin() { return 22; }
+    static constexpr size_t n_face_joints() { return 3; }
     static constexpr const char* default_path_prefix = "models/smplx/SMPLX_";
     static constexpr const char* default_uv_path = "models/smplx/uv.txt";
 };
@@ -100,6 +109,7 @@ struct SMPLXpca : public internal::SMPLXBase<SMPLXpca> {
     static constexpr size_t n_explicit_joints() { return 25; }
     static constexpr size_t n_hand_pca_joints() { return 15; }
     static constexpr size_t n_shape_blends() { return 400; }
+    static constexpr size_t n_expression_blends() { return 100; }
     static constexpr size_t n_hand_pca() { return 6; }
     static constexpr const char* model_name = "SMPL-X v1.1 (with hand PCA)";
 };
@@ -110,6 +120,9 @@ struct SMPLX : public internal::SMPLXBase<SMPLX> {
     static constexpr size_t n_shape_blends() {
         return SMPLXpca::n_shape_blends();
     }
+    static constexpr size_t n_expression_blends() {
+        return SMPLXpca::n_expression_blends();
+    }
     static constexpr const char* model_name = "SMPL-X v1.1";
 };
 
@@ -121,6 +134,7 @@ struct SMPLXpca_v1 : public internal::SMPLXBase<SMPLXpca_v1> {
     }  // 3 facial joints
     static constexpr size_t n_hand_pca_joints() { return 15; }
     static constexpr size_t n_shape_blends() { return 20; }
+    static constexpr size_t n_expression_blends() { return 10; }
     static constexpr size_t n_hand_pca() { return 6; }
     static constexpr const char* model_name = "SMPL-X v1.0 (with hand PCA)";
 };
@@ -133,6 +147,9 @@ struct SMPLX_v1 : public internal::SMPLXBase<SMPLX_v1> {
     static constexpr size_t n_shape_blends() {
         return SMPLXpca_v1::n_shape_blends();
     }
+    static constexpr size_t n_expression_blends() {
+        return SMPLXpca_v1::n_expression_blends();
+    }
     static constexpr const char* model_name = "SMPL-X v1.0";
 };
 
@@ -0,0 +1,125 @@
+#pragma once
+#ifndef SMPLX_MODEL_REGISTRY_F5D614CC_7424_4C07_96F6_726C7C829498
+#define SMPLX_MODEL_REGISTRY_F5D614CC_7424_4C07_96F6_726C7C829498
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+
+#include "smplx/smplx.hpp"
+
+namespace smplx {
+
+/** Cache of loaded models, so each model is loaded once and shared:
+ *  get() returns the same immutable model to all callers. Models may be
+ *  preloaded in the background, e.g. every gender of a mixed-gender
+ *  dataset, so switching models does not wait on loading. Models no one
+ *  else holds stay cached within a memory budget, evicted least recently
+ *  used first. Thread-safe.
+ *
+ *  template arg ModelConfig is the static 'model configuration', as for
+ *  Model; a registry holds models of one configuration. */
+template <class ModelConfig>
+class ModelRegistry {
+   public:
+    using ModelPtr = std::shared_ptr<const Model<ModelConfig>>;
+
+    // memory_budget: bytes (see memory_usage) above which models no one
+    // else holds are evicted; 0 = no limit
+    explicit ModelRegistry(size_t memory_budget = 0);
+    // Waits for models being loaded
+    ~ModelRegistry();
+
+    ModelRegistry(const ModelRegistry&) = delete;
+    ModelRegistry& operator=(const ModelRegistry&) = delete;
+
+    // Model at the default path for gender (see Model(Gender)), loaded
+    // unless cached; waits if it is being loaded, or loads it on the
+    // calling thread if preloaded but not started (so a ThreadPool worker
+    // never waits on a load queued behind it).
+    // Throws std::runtime_error if it cannot be loaded; a failed load is
+    // retried by the next call.
+    ModelPtr get(Gender gender = Gender::neutral);
+    // Model at path (see Model(path, uv_path, gender)), as get(gender)
+    ModelPtr get(const std::string& path, const std::string& uv_path = "",
+                 Gender gender = Gender::unknown);
+
+    // Start loading the model on ThreadPool::global() unless cached, with
+    // all its components (see Model::preload), and return immediately.
+    // Load errors are reported by get().
+    void preload(Gender gender = Gender::neutral);
+    void preload(const std::string& path, const std::string& uv_path = "",
+                 Gender gender = Gender::unknown);
+
+    // True if the model is cached (loaded or being loaded)
+    bool contains(Gender gender) const;
+    bool contains(const std::string& path, const std::string& uv_path = "",
+                  Gender gender = Gender::unknown) const;
+
+    // Set the memory budget (0 = no limit), evicting models if over it
+    void set_memory_budget(size_t bytes);
+    size_t memory_budget() const;
+    // Approximate bytes of the data of the loaded models (see
+    // Model::memory_usage)
+    size_t memory_usage() const;
+    // Number of cached models, including those being loaded
+    size_t size() const;
+    // Evict all models no one else holds
+    void clear();
+
+    // Process-wide registry, with no memory budget, created on first use
+    static ModelRegistry& global();
+
+   private:
+    // Path (empty for the default path of gender), UV map path, gender
+    using Key = std::tuple<std::string, std::string, Gender>;
+    // Load of a model, run once by whichever thread claims it first: the
+    // pool, or a get() of the model
+    struct Load {
+        std::atomic<bool> started{false};
+        std::function<void()> run;
+        inline void run_once() {
+            if (!started.exchange(true)) run();
+        }
+    };
+    struct Entry {
+        std::shared_future<ModelPtr> model;
+        // Null once loaded
+        std::shared_ptr<Load> load;
+        // Value of _clock when last returned
+        uint64_t last_used;
+    };
+    // Bytes (see Model::memory_usage) of loaded models
+    using Sizes = std::map<const Model<ModelConfig>*, size_t>;
+
+    // Future of the model of key, loading it if not cached: now, or on
+    // ThreadPool::global() (with all components) if background
+    std::shared_future<ModelPtr> _find_or_load(const Key& key,
+                                               bool background);
+    // Load the model of key into promise, with all components if
+    // background, then evict over budget
+    void _load(const Key& key, std::promise<ModelPtr>& promise,
+               bool background);
+    // Sizes of the loaded models, taken without _mtx held since
+    // Model::memory_usage locks the model's components
+    Sizes _sizes() const;
+    // Evict models no one else holds, least recently used first, while
+    // their sizes plus loading bytes (of a model about to be added) are
+    // over budget, or all of them if all; with _mtx held
+    void _evict(bool all, const Sizes& sizes, size_t loading = 0);
+
+    std::map<Key, Entry> _entries;
+    uint64_t _clock = 0;
+    size_t _memory_budget;
+    mutable std::mutex _mtx;
+};
+
+}  // namespace smplx
+
+#endif  // ifndef SMPLX_MODEL_REGISTRY_F5D614CC_7424_4C07_96F6_726C7C829498
@@ -0,0 +1,108 @@
+#pragma once
+#ifndef SMPLX_POSE_CACHE_468E055C_AB7C_4DF0_80E3_8F647CB085A4
+#define SMPLX_POSE_CACHE_468E055C_AB7C_4DF0_80E3_8F647CB085A4
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "smplx/defs.hpp"
+
+namespace smplx {
+
+/** Approximate cache of pose blend shape offsets (the pose-corrective
+ *  vertex displacements, the most expensive part of an update), keyed on
+ *  the model and the quantized pose. A pose hits an entry if the
+ *  angle-axis pose of every (non-root) joint is within tolerance of that
+ *  of the pose the entry was computed from, so the joint rotations differ
+ *  by at most tolerance (radians). Lookup is by quantization cell, whose
+ *  poses are all within tolerance of each other, else by a scan of the
+ *  entries of the model. Pose offsets do not depend on shape, so a cache
+ *  may be shared by all bodies (see Body::set_pose_cache); the model is
+ *  identified by its address and Model::generation(), so entries of
+ *  another model, or of an earlier load of the model, never hit.
+ *  Entries are evicted least recently used first. Thread-safe. */
+class PoseCache {
+   public:
+    // Cached offsets, (3 * #verts)
+    using Offsets = std::shared_ptr<const Vector>;
+
+    // capacity: max number of entries; each takes 12 * #verts bytes.
+    // tolerance: max rotation difference per joint for a hit, in radians
+    explicit PoseCache(size_t capacity = 256, Scalar tolerance = 1e-2f);
+
+    PoseCache(const PoseCache&) = delete;
+    PoseCache& operator=(const PoseCache&) = delete;
+
+    // Offsets of the entry of the model (see class doc) for full_pose
+    // (angle-axis, 3*#joints; the root joint is ignored) and mark it most
+    // recently used; nullptr on miss. Counts a hit or a miss.
+    Offsets find(const void* model, uint64_t generation,
+                 const Vector& full_pose);
+
+    // Add offsets of the model for full_pose, evicting the least recently
+    // used entry if full. Keeps an existing entry for the same cell.
+    void insert(const void* model, uint64_t generation,
+                const Vector& full_pose, Offsets offsets);
+
+    // Remove all entries (counters are kept)
+    void clear();
+
+    // Number of entries
+    size_t size() const;
+    inline size_t capacity() const { return _capacity; }
+    inline Scalar tolerance() const { return _tolerance; }
+
+    // Lookup counters
+    size_t hits() const;
+    size_t misses() const;
+    void reset_stats();
+
+   private:
+    struct Key {
+        const void* model;
+        uint64_t generation;
+        // Quantization cell of the pose
+        std::vector<int32_t> cell;
+        bool operator==(const Key& other) const {
+            return model == other.model && generation == other.generation &&
+                   cell == other.cell;
+        }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+    // Immutable once added, so scans can read it unlocked
+    struct Entry {
+        Key key;
+        // Pose the offsets were computed from, without the root
+        Vector pose;
+        Offsets offsets;
+    };
+    using EntryPtr = std::shared_ptr<const Entry>;
+
+    // Key of full_pose for the model
+    Key _key(const void* model, uint64_t generation,
+             const Vector& full_pose) const;
+
+    const size_t _capacity;
+    const Scalar _tolerance;
+    // Quantization step of each angle-axis component
+    const Scalar _step;
+    // True if every joint of pose (without the root) is within tolerance
+    // of that of entry
+    bool _near(const Entry& entry, const Vector& pose) const;
+
+    // Entries, most recently used first
+    std::list<EntryPtr> _lru;
+    std::unordered_map<Key, std::list<EntryPtr>::iterator, KeyHash> _index;
+    size_t _hits = 0, _misses = 0;
+    mutable std::mutex _mtx;
+};
+
+}  // namespace smplx
+
+#endif  // ifndef SMPLX_POSE_CACHE_468E055C_AB7C_4DF0_80E3_8F647CB085A4
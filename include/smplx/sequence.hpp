@@ -30,13 +30,13 @@ class Sequence {
 
     // Set body shape
     template <class ModelConfig>
-    inline void set_shape(Body<ModelConfig>& body) {
+    inline void set_shape(Body<ModelConfig>& body) const {
         internal::SequenceModelSpec<SequenceConfig, ModelConfig>::set_shape(
             *this, body);
     }
     // Set body pose
     template <class ModelConfig>
-    inline void set_pose(Body<ModelConfig>& body, size_t frame) {
+    inline void set_pose(Body<ModelConfig>& body, size_t frame) const {
         internal::SequenceModelSpec<SequenceConfig, ModelConfig>::set_pose(
             *this, body, frame);
     }
@@ -71,6 +71,82 @@ class Sequence {
 // An AMASS sequence
 using SequenceAMASS = Sequence<sequence_config::AMASS>;
 
+// How SequenceEvaluator reconstructs the frames between keyframes
+enum class SequenceInterp {
+    // Exact joint transforms and LBS at each frame; only the shaped vertices
+    // (i.e. pose blend shapes) are interpolated between keyframes
+    skinning,
+    // Posed vertices interpolated linearly between keyframes; cheapest per
+    // frame, but needs more keyframes
+    vertices,
+};
+
+/** Approximate evaluation of a whole Sequence, e.g. for playback or export:
+ *  only keyframes get a full Body::update(), frames in between are
+ *  reconstructed from them. Keyframes are placed where the pose moves
+ *  nonlinearly: each frame's joint rotations are compared against linear
+ *  interpolation between the surrounding keyframes, which gives a bound on
+ *  the vertex error, kept below max_error.
+ *  Supported models are those supported by Sequence::set_pose */
+template <class SequenceConfig, class ModelConfig>
+class SequenceEvaluator {
+   public:
+    // seq, body: sequence to evaluate and body to evaluate it with; body's
+    // shape is set from seq, and both must outlive the evaluator.
+    // max_error: max vertex error, in model units (meters)
+    SequenceEvaluator(const Sequence<SequenceConfig>& seq,
+                      Body<ModelConfig>& body, Scalar max_error = 1e-3f,
+                      SequenceInterp interp = SequenceInterp::skinning);
+
+    // Posed vertices at frame, (#verts, 3), valid until the next call.
+    // Sets body params to the pose at frame. Sequential access is fastest,
+    // since the keyframes around the latest frame are cached.
+    const Points& verts(size_t frame);
+
+    // Keyframes, ascending, including the first and last frames
+    inline const std::vector<size_t>& keyframes() const { return _keyframes; }
+
+    // Bound on the vertex error at frame (first order in the interpolation
+    // error of the joint rotations); 0 at keyframes
+    Scalar error_bound(size_t frame) const;
+
+    const Sequence<SequenceConfig>& seq;
+    Body<ModelConfig>& body;
+    const Scalar max_error;
+    const SequenceInterp interp;
+
+   private:
+    // Local joint rotations at each frame, row-major 3x3,
+    // (#frames * #joints * 9)
+    std::vector<Scalar> _rotations;
+    // vertices mode: joint transforms at each frame, row-major 3x4,
+    // (#frames * #joints * 12)
+    std::vector<Scalar> _transforms;
+    // Per joint: max Frobenius norm over vertices of its pose blend shapes
+    // (3x9 block of a vertex); max norm of the shaped vertices it skins
+    std::vector<Scalar> _blend_norm, _skin_radius;
+    std::vector<size_t> _keyframes;
+
+    // Outputs of a keyframe
+    struct Key {
+        size_t frame = -1;
+        Points verts, verts_shaped;
+    };
+    // The keyframes around the latest frame
+    Key _keys[2];
+    // Joints and joint transforms of the latest frame (skinning mode)
+    internal::BodyOutputs _frame;
+    // Reconstructed vertices
+    Points _verts, _verts_shaped;
+
+    // Bound on the vertex error at frame t interpolated from keyframes a, b
+    Scalar _bound(size_t a, size_t b, size_t t) const;
+    // True if every frame strictly between a and b is within max_error
+    bool _segment_ok(size_t a, size_t b) const;
+    // Cached outputs of keyframe; other: keyframe which must stay cached
+    const Key& _key(size_t frame, size_t other);
+};
+
 }  // namespace smplx
 
 #endif  // ifndef SMPLX_SEQUENCE_9512D947_1D9B_478F_AAB5_6E6A846A6828
@@ -4,8 +4,20 @@
 
 #include "smplx/defs.hpp"
 #include "smplx/model_config.hpp"
-
+#include "smplx/internal/backend.hpp"
+#include "smplx/internal/model_bin.hpp"
+#include "smplx/pose_cache.hpp"
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #define __SMPLX_MEMBER_ACCESSOR(name, body) \
@@ -13,17 +25,9 @@
     inline auto name() const { return body; }
 
 namespace smplx {
-#ifdef SMPLX_CUDA_ENABLED
 namespace internal {
-// Basic CSR sparse matrix repr
-struct GPUSparseMatrix {
-    float* values = nullptr;
-    int* inner = nullptr;
-    int* outer = nullptr;
-    int rows, cols, nnz;
-};
-}  // namespace internal
-#endif
+class NpzReader;
+}
 
 /** Represents a generic SMPL-like human model.
  *  This contains the base shape/mesh/LBS weights of a SMPL-type
@@ -39,10 +43,11 @@ template <class ModelConfig>
 class Model {
    public:
     // Construct from .npz at default path for given gender, in
-    // data/models/modelname/MODELNAME_GENDER.npz
+    // data/models/modelname/MODELNAME_GENDER.npz (or .smplxbin, see load)
     explicit Model(Gender gender = Gender::neutral);
 
-    // Construct from .npz at path (standard SMPL-X npz format)
+    // Construct from .npz at path (standard SMPL-X npz format),
+    // or .smplxbin (see load)
     // path: .npz model path, e.g. data/models/smplx/*.npz
     // uv_path: UV map information path, see data/models/smplx/uv.txt for an
     // example gender: records gender of model. For informational purposes only.
@@ -51,21 +56,102 @@ class Model {
     // Destructor
     ~Model();
 
-    // Disable copy/move assignment
+    // Disable copy/move; bodies and backend states refer to the model
+    Model(const Model& other) = delete;
     Model& operator=(const Model& other) = delete;
     Model& operator=(Model&& other) = delete;
 
     /*** MODEL NPZ LOADING ***/
     // Load from .npz at default path for given gender
-    // useful for dynamically switching genders
+    // useful for dynamically switching genders. Prefers the embedded
+    // MODELNAME_GENDER (see load_embedded), then MODELNAME_GENDER.smplxbin,
+    // if present and saved from this ModelConfig.
     void load(Gender gender = Gender::neutral);
     // Load from .npz at path (standard SMPL-X npz format)
     // path: .npz model path, in data/models/smplx/*.npz
     // uv_path: UV map information path, see data/models/smplx/uv.txt for an
     // example gender: records gender of model. For informational purposes only.
+    // path may also be a .smplxbin (see save_binary), detected by its
+    // contents: it is memory-mapped and blend_shapes points into it, so
+    // loading is fast and pages are read on demand; uv_path is then only
+    // used if the file has no UV map, and gender defaults to the saved one.
+    // Throws std::invalid_argument if the .smplxbin does not match this
+    // ModelConfig, std::runtime_error if it cannot be mapped or is corrupt;
+    // the model is then left unchanged.
+    // From .npz, only the template mesh, skeleton and weights are read
+    // here; the rest is loaded on first use (see require).
     void load(const std::string& path, const std::string& uv_path = "",
               Gender new_gender = Gender::unknown);
 
+    // Save the loaded model data (without deformations) as .smplxbin, a
+    // memory-mappable binary format which load() reads with no parsing.
+    // Throws std::runtime_error if the file cannot be written.
+    void save_binary(const std::string& path) const;
+
+    /*** CROSS-PROCESS SHARING (POSIX shared memory) ***/
+    // Publish the model data (as .smplxbin, see save_binary) in the named
+    // shared memory segment, e.g. "/smplx_neutral", replacing any segment of
+    // that name; processes attached to the old one keep their data. The
+    // segment stays until unlink_shared(name) or reboot.
+    // Throws std::runtime_error on failure.
+    void publish_shared(const std::string& name) const;
+    // Load from the named segment, published by any process: the data is
+    // mapped read-only and blend_shapes points into it, so all attached
+    // processes share one copy. Throws std::runtime_error if the segment
+    // does not exist, is not yet published or is corrupt,
+    // std::invalid_argument if it holds another ModelConfig.
+    // Returns true if the attach is counted in shared_info(name); it is not
+    // if the segment is read-only to this process, as it is to users other
+    // than the publisher's.
+    bool load_shared(const std::string& name);
+    // Remove the named segment; returns false if it did not exist
+    static bool unlink_shared(const std::string& name) {
+        return internal::unlink_shared_image(name);
+    }
+    // Generation (1 for the first publish under a name, incremented by each
+    // publish) and number of models attached across processes (see
+    // load_shared), of the named segment; throws std::runtime_error if it
+    // does not exist
+    static internal::SharedImageInfo shared_info(const std::string& name) {
+        return internal::shared_image_info(name);
+    }
+
+    /*** EMBEDDED MODELS ***/
+    // Load the .smplxbin compiled into the library by the SMPLX_EMBED_MODELS
+    // CMake option, by its file name without extension, e.g. "SMPLX_NEUTRAL":
+    // blend_shapes points into the read-only data of the executable, so
+    // nothing is read from files (the UV map only if converted with one).
+    // Throws std::invalid_argument if there is no such model or it was
+    // saved from another ModelConfig.
+    void load_embedded(const std::string& name);
+    // Names of the models compiled into the library
+    static std::vector<std::string> embedded_names() {
+        return internal::embedded_image_names();
+    }
+
+    /*** LAZY LOADING ***/
+    // Loaded from .npz, the components in ModelComponent (blend shapes, hand
+    // PCA, UV map, face region) are read on first use: bodies load what
+    // their updates need, so e.g. tools using only the template mesh or the
+    // skeleton never read the rest. Members of a component not loaded yet
+    // are empty or uninitialized; code reading them directly must call
+    // require() or preload() first.
+
+    // Load component if not loaded yet. Thread-safe.
+    // Throws std::runtime_error if the .npz (or UV map) cannot be read.
+    void require(ModelComponent component) const;
+    // Load the components not loaded yet, concurrently on
+    // ThreadPool::global()
+    void require(std::initializer_list<ModelComponent> components) const;
+    // Load all components (concurrently), e.g. so updates of a
+    // latency-sensitive service never wait on loading
+    void preload() const;
+    // True if component is loaded
+    inline bool is_loaded(ModelComponent component) const {
+        return (_components.load(std::memory_order_acquire) &
+                _component_bit(component)) != 0;
+    }
+
     /*** MODEL MANIPULATION ***/
     // Set model deformations: verts := verts_load + d
     void set_deformations(const Eigen::Ref<const Points>& d);
@@ -73,6 +159,84 @@ class Model {
     // Set model template: verts := t
     void set_template(const Eigen::Ref<const Points>& t);
 
+    /*** MEMORY ***/
+    // Host memory of the model data by part (verts, blend_shapes, ...),
+    // counting loaded components only. Arrays shared with other models
+    // (faces, vert_faces, UV map) or mapped from a .smplxbin image are
+    // counted in full by each model using them.
+    MemoryUsage memory_usage() const;
+
+    // Back blend_shapes, which every update streams through, with huge
+    // pages (2 MB) to cut TLB misses; moves them now and applies to later
+    // loads from .npz (a mapped .smplxbin uses the pages of the file).
+    // Call it before creating bodies, as set_shape_space.
+    void set_huge_pages(HugePages mode);
+    inline HugePages huge_pages() const { return _huge_pages; }
+
+    // Make the first updates as fast as the next ones, e.g. before a
+    // service takes requests: load all components, fault in the pages
+    // of the data read by updates (blend shapes, template, weights,
+    // regressor), pinning them in RAM with mlock if lock_memory (a
+    // warning is printed if the memlock limit is too low), then run one
+    // update on each available backend but cpu_reference, creating the
+    // backend states and warming up the thread pool. The CPU backends
+    // run the one kernel variant (ISA) picked for this CPU at first use
+    // (see SMPLX_CPU_ISA), so only that variant is warmed. Pages stay
+    // locked until the model is reloaded or destroyed.
+    void warmup(bool lock_memory = false) const;
+
+    /*** SHAPE SPACE ***/
+    // Keep only the first n_body_shape body shape blend shapes and, for
+    // models with a face, the first n_expression expression blend shapes,
+    // e.g. 16 and 10 of the 300 and 100 of SMPL-X v1.1. blend_shapes,
+    // joint_shape_blends, the params layout and Body::shape shrink
+    // accordingly, saving memory and blend shape cost in every update.
+    // Applies now, dropping the other columns (loaded from .npz, those
+    // not loaded yet are never read), and to later loads: call it before
+    // creating bodies, or call load() after it. Counts above those of the
+    // model data take effect on the next load().
+    void set_shape_space(size_t n_body_shape, size_t n_expression = 0);
+
+    // (3*#verts, #blend shapes), column-major
+    using BlendShapes = MatrixColMajor;
+
+    /*** LEVELS OF DETAIL ***/
+    // See LevelOfDetail
+    using LOD = LevelOfDetail;
+
+    // Add a level of detail by decimating the template mesh to about
+    // target_verts vertices; returns its level (levels start at 1,
+    // level 0 is the full mesh). See Body::set_lod.
+    // Not thread-safe w.r.t. updating bodies of this model.
+    size_t add_lod(size_t target_verts);
+    // Add a level of detail from a given vertex subset (model vertex indices)
+    // and triangles indexing into it, e.g. from an external decimation tool
+    size_t add_lod(const std::vector<Index>& vert_ids, const Triangles& faces);
+    // Remove all levels of detail; bodies set to one keep evaluating its
+    // data (see lod_ptr) until set_lod() is called again
+    void clear_lods();
+    // Number of levels of detail, including level 0 (the full mesh)
+    inline size_t n_lods() const { return _lods.size() + 1; }
+    // Level of detail at level (1 <= level < n_lods())
+    inline const LOD& lod(size_t level) const { return *_lods[level - 1]; }
+    // As lod(level), shared: kept alive by the holder after clear_lods()
+    inline std::shared_ptr<const LOD> lod_ptr(size_t level) const {
+        return _lods[level - 1];
+    }
+
+    /*** COMPUTE BACKEND ***/
+    // Set the backend used by bodies of this model which do not set their
+    // own (see Body::set_backend). automatic: CUDA if available, else cpu_simd.
+    // Throws std::invalid_argument if backend is not available in this build
+    void set_backend(Backend backend);
+    // Backend set by set_backend (may be automatic)
+    inline Backend backend() const { return _backend; }
+
+    // ADVANCED: state of the given backend for this model (e.g. a device copy
+    // of the model data), created on first use. backend must be available
+    // and not automatic. Thread-safe.
+    internal::ModelBackend<ModelConfig>& backend_data(Backend backend) const;
+
     using Config = ModelConfig;
 
     /*** STATIC DATA SHAPE INFO SHORTHANDS,
@@ -95,21 +259,27 @@ class Model {
     }
 
     // Total number of blend shapes = n_shape_blends + n_pose_blends
-    static constexpr size_t n_blend_shapes() {
-        return Config::n_blend_shapes();
-    }
-    // Number of shape-dep blend shapes, including body and face
-    static constexpr size_t n_shape_blends() {
-        return Config::n_shape_blends();
+    // NOTE: not static or a constexpr (see set_shape_space)
+    inline size_t n_blend_shapes() const {
+        return _n_shape_blends + n_pose_blends();
     }
+    // Number of shape-dep blend shapes, including body and face; at most
+    // Config::n_shape_blends() (see set_shape_space)
+    inline size_t n_shape_blends() const { return _n_shape_blends; }
     // Number of pose-dep blend shapes = 9 * (n_joints - 1)
     static constexpr size_t n_pose_blends() { return Config::n_pose_blends(); }
+    // Number of expression blend shapes, the last ones among the shape-dep
+    // blend shapes; 0 if the model has no face
+    inline size_t n_expression_blends() const { return _n_expression_blends; }
 
     // Number of PCA components for each hand
     static constexpr size_t n_hand_pca() { return Config::n_hand_pca(); }
 
     // Total number of params = 3 + 3 * n_body_joints + 2 * n_hand_pca +
-    static constexpr size_t n_params() { return Config::n_params(); }
+    // n_shape_blends
+    inline size_t n_params() const {
+        return Config::n_params() - Config::n_shape_blends() + _n_shape_blends;
+    }
 
     // Number UV vertices (may be more than n_verts due to seams)
     // 0 if UV not available
@@ -135,7 +305,16 @@ class Model {
     // Note: not static, since we allow UV map variation among model instances.
     inline bool has_uv_map() const { return _n_uv_verts > 0; }
 
+    // Identifies the loaded model data: changes when it is reloaded or its
+    // blend shapes change, and is unique among all models of the process;
+    // 0 before the first load
+    inline uint64_t generation() const { return _generation; }
+
     /*** MODEL DATA ***/
+    // The mesh topology (faces, vert_faces and the UV map) is read-only
+    // and shared by all models with identical arrays, e.g. the genders of
+    // a model (see internal::share_array).
+
     // Kinematic tree: joint children
     std::vector<std::vector<size_t>> children;
 
@@ -143,63 +322,173 @@ class Model {
     // This is verts_load with deformations (set with set_deformations).
     Points verts;
 
-    // Vertices in the initial loaded mesh, (#verts, 3)
+    // Vertices in the initial loaded mesh, (#verts, 3). Empty (verts being
+    // the loaded mesh) until set_deformations or set_template first changes
+    // verts, so models which are never deformed keep one copy.
     Points verts_load;
 
     // Triangles in the mesh, (#faces, 3)
-    Triangles faces;
+    Eigen::Map<const Triangles> faces{nullptr, 0, 3};
+
+    // Vertex-face adjacency, (#verts, #faces) CSR with unit values;
+    // row i lists the faces incident to vertex i
+    Eigen::Map<const SparseMatrix> vert_faces{0, 0, 0, nullptr, nullptr,
+                                              nullptr};
 
     // Initial joint positions
     Points joints;
 
     // Shape- and pose-dependent blend shapes,
     // (3*#verts, #shape blends + #pose blends)
-    // each col represents a point cloud (#verts, 3) in row-major order
-    Eigen::Matrix<Scalar, Eigen::Dynamic, Model::n_blend_shapes()> blend_shapes;
+    // each col represents a point cloud (#verts, 3) in row-major order.
+    // Read-only view of memory owned by the model, or of the mapped file
+    // if loaded from .smplxbin
+    Eigen::Map<const BlendShapes> blend_shapes;
 
     // Joint regressor: verts -> joints, (#joints, #verts)
     SparseMatrix joint_reg;
 
+    // Shape blend shapes of the joints, i.e. joint_reg applied to each
+    // shape blend shape, (3*#joints, #shape blends)
+    // each col represents joint positions (#joints, 3) in row-major order
+    mutable MatrixColMajor joint_shape_blends;
+
     // LBS weights, (#verts, #joints).
-    // NOTE: this is ColMajor because I notice a speedup while profiling
-    SparseMatrixColMajor weights;
+    // NOTE: this is RowMajor (CSR) so the LBS kernel can gather the weights
+    // of each vertex
+    SparseMatrix weights;
+
+    /*** Face region, see Body::update_face ***/
+    // Vertices which may move when only the expression params and the pose
+    // of the face joints (jaw, eyes) change, sorted. Found from the nonzero
+    // rows of the expression and face pose blend shapes, the joint regressor
+    // and the LBS weights. Empty if the model has no face, or if the region
+    // covers most of the mesh.
+    mutable std::vector<Index> face_verts;
+    // Rows of blend_shapes at face_verts, for the expression blend shapes
+    // followed by the pose blend shapes of the face joints,
+    // (3*#face verts, #expression blends + 9*#face joints)
+    mutable MatrixColMajor face_blend_shapes;
 
     /*** Hand PCA data ***/
     // Hand PCA comps: pca -> joint pos delta
     // 3*#hand joints (=45) * #hand pca
     // columns are PC's
-    Matrix hand_comps_l, hand_comps_r;
+    mutable Matrix hand_comps_l, hand_comps_r;
     // Hand PCA means: mean pos of 3x15 hand joints
-    Vector hand_mean_l, hand_mean_r;
+    mutable Vector hand_mean_l, hand_mean_r;
 
     /*** UV Data , available if has_uv_map() ***/
     // UV coordinates, size (n_uv_verts, 2)
-    Points2D uv;
+    mutable Eigen::Map<const Points2D> uv{nullptr, 0, 2};
     // UV triangles (indices in uv), size (n_faces, 3)
-    Triangles uv_faces;
-
-#ifdef SMPLX_CUDA_ENABLED
-    /*** ADVANCED: GPU data pointers ***/
-    struct {
-        float* verts = nullptr;
-        float* blend_shapes = nullptr;
-        internal::GPUSparseMatrix joint_reg;
-        float* joint_reg_dense;
-        internal::GPUSparseMatrix weights;
-        float *hand_comps_l = nullptr, *hand_comps_r = nullptr;
-        float *hand_mean_l = nullptr, *hand_mean_r = nullptr;
-    } device;
+    mutable Eigen::Map<const Triangles> uv_faces{nullptr, 0, 3};
+    // Mesh vertex index of each UV vertex, size (n_uv_verts).
+    // UV vertices along seams map to the same mesh vertex; this is used to
+    // expand per-vertex data to the UV vertices (see Body::verts_uvn)
+    mutable Eigen::Map<const IndexVector> uv_to_vert{nullptr, 0};
 
    private:
-    void _cuda_load();
-    void _cuda_copy_template();
-    void _cuda_free();
-#else
-   private:
-#endif
     // Number UV vertices (may be more than n_verts due to seams)
     // 0 if UV not available
     size_t _n_uv_verts;
+
+    // Shape blend shapes in the model data, the last _n_expression_blends
+    // being expression
+    size_t _n_shape_blends = ModelConfig::n_shape_blends();
+    size_t _n_expression_blends = ModelConfig::n_expression_blends();
+    // Shared arrays viewed by faces, vert_faces and the UV map
+    std::shared_ptr<const Triangles> _faces_data;
+    std::shared_ptr<const SparseMatrix> _vert_faces_data;
+    mutable std::shared_ptr<const Points2D> _uv_data;
+    mutable std::shared_ptr<const Triangles> _uv_faces_data;
+    mutable std::shared_ptr<const IndexVector> _uv_to_vert_data;
+
+    // Limits set by set_shape_space
+    size_t _max_body_shape =
+        ModelConfig::n_shape_blends() - ModelConfig::n_expression_blends();
+    size_t _max_expression = ModelConfig::n_expression_blends();
+    // Drop the shape blend shapes beyond the set_shape_space limits from
+    // the model data
+    void _truncate_shape_space();
+
+    // Storage of blend_shapes if not mapped (see internal::allocate_pages);
+    // columns of components not loaded yet are allocated but never
+    // written, so take no memory
+    std::shared_ptr<void> _blend_shapes_storage;
+    // Page backing of _blend_shapes_storage, set by set_huge_pages
+    HugePages _huge_pages = HugePages::off;
+    // New storage for n_cols blend shapes, backed as _huge_pages
+    std::shared_ptr<void> _new_blend_shapes(size_t n_cols) const;
+    // Keeps the mapped file alive, if loaded from .smplxbin
+    std::shared_ptr<const void> _image_owner;
+    // Point blend_shapes at data, (3*#verts, #blend shapes)
+    void _set_blend_shapes(const Scalar* data);
+
+    // Finish loading: derived data, UV map (from uv_path if not loaded),
+    // levels of detail and backends
+    void _loaded(const std::string& uv_path);
+    // Update what derives from the model data: generation, face region,
+    // levels of detail and backends
+    void _data_changed();
+    // See generation()
+    uint64_t _generation = 0;
+    // Load model data from .npz at path
+    void _load_npz(const std::string& path);
+    // Load model data from .smplxbin image, using it in place
+    void _load_binary(const internal::BinaryImage& image);
+    // Load UV map from text file at uv_path (or its binary cache, see
+    // internal::load_uv_map), with _n_uv_verts vertices
+    void _load_uv(const std::string& uv_path) const;
+
+    // Source of the components not loaded yet, if loaded from .npz
+    std::unique_ptr<internal::NpzReader> _npz;
+    // UV map text file, if the UV map is loaded from one
+    std::string _uv_path;
+    // Loaded components, a bit per ModelComponent
+    mutable std::atomic<unsigned> _components{0};
+    // Held while loading each component, so different ones load
+    // concurrently
+    mutable std::array<std::mutex, 5> _component_mtx;
+    static constexpr unsigned _component_bit(ModelComponent component) {
+        return 1u << static_cast<unsigned>(component);
+    }
+    // Load component if not loaded yet, with its _component_mtx held
+    void _load_component(ModelComponent component) const;
+    // .smplxbin header and start of each section of the model data;
+    // returns the image size in bytes
+    uint64_t _binary_layout(
+        internal::smplxbin::Header& header,
+        const void* data[internal::smplxbin::n_sections]) const;
+
+    // Ranges pinned by warmup(lock_memory), unlocked by _unlock_pages
+    // before their data is replaced or freed
+    mutable std::vector<std::pair<const void*, size_t>> _locked_pages;
+    mutable std::mutex _locked_pages_mtx;
+    // Fault in the data read by updates, pinning it if lock (see warmup)
+    void _prefault_pages(bool lock) const;
+    // Unpin _locked_pages; returns true if any were pinned, so the data
+    // replacing them is pinned again
+    bool _unlock_pages();
+
+    // Backend set by set_backend
+    Backend _backend = Backend::automatic;
+    // Backend states created so far, indexed by Backend
+    mutable std::array<std::unique_ptr<internal::ModelBackend<ModelConfig>>,
+                       5>
+        _backend_data;
+    mutable std::mutex _backend_mtx;
+
+    // Notify backend states of a change to verts
+    void _template_changed();
+    // Find face_verts and gather face_blend_shapes
+    void _compute_face_region() const;
+
+    // Levels of detail 1, 2, ...; shared with the bodies set to them, so
+    // references stay valid
+    std::vector<std::shared_ptr<LOD>> _lods;
+    // Gather the model data of lod at lod.vert_ids
+    void _gather_lod(LOD& lod) const;
 };
 // SMPL Model
 using ModelS = Model<model_config::SMPL>;
@@ -220,14 +509,116 @@ class Body {
     // Construct body from model
     // set_zero: set to false to leave parameter array uninitialized
     explicit Body(const Model<ModelConfig>& model, bool set_zero = true);
+    // Copy parameters and outputs; backend state is not shared
+    Body(const Body& other);
     ~Body();
 
     // Perform LBS and output verts
+    // force_cpu: if the backend in use is cuda, use cpu_simd instead
     // enable_pose_blendshapes: if false, disables pose blendshapes;
     //                          this provides a significant speedup at the cost
     //                          of worse accuracy
     void update(bool force_cpu = false, bool enable_pose_blendshapes = true);
 
+    // Run update() on ThreadPool::global() and return immediately.
+    // Output accessors block until the outputs are ready; params, backend
+    // and the body itself must not be modified from other threads until the
+    // returned future is ready (or wait() returns).
+    // then: optional continuation run on the worker after the update
+    // (e.g. export). The returned future becomes ready after the
+    // continuation and rethrows its exceptions, or those of the update.
+    // Inside the continuation, the body's const members may be called:
+    // output accessors, wait() (which returns at once) and copying the
+    // body; another thread's wait() still blocks until it returns. It must
+    // not wait for another update_async() of the body, e.g. from a task it
+    // starts.
+    std::shared_future<void> update_async(
+        bool force_cpu = false, bool enable_pose_blendshapes = true,
+        std::function<void(const Body&)> then = nullptr);
+
+    // Fast path for face animation (SMPL-X): like update(), but if only the
+    // expression params and the pose of the face joints (jaw, eyes) changed
+    // since the latest update(), recomputes only model.face_verts and the
+    // joints, keeping the rest of the previous outputs. Otherwise, or if the
+    // model has no face region, runs update(). The fast path runs on the CPU.
+    // Returns true if the fast path was taken.
+    bool update_face(bool enable_pose_blendshapes = true);
+
+    // Wait for the latest update_async(), including its continuation;
+    // returns at once when called from the continuation
+    inline void wait() const {
+        if (std::this_thread::get_id() == _continuation_thread.load()) return;
+        const std::shared_future<void> pending = _load_future(_pending);
+        if (pending.valid()) pending.wait();
+    }
+
+    // Set the backend used by update(); automatic: use model.backend().
+    // Throws std::invalid_argument if backend is not available in this build
+    void set_backend(Backend backend);
+    // Backend set by set_backend (may be automatic)
+    inline Backend backend() const { return _backend; }
+
+    // Set the level of detail evaluated by update(): 0 = full mesh, else
+    // model.lod(level) (see Model::add_lod). Levels >= 1 are evaluated on
+    // the CPU whatever the backend; vertex outputs then have the vertices of
+    // the level, to be drawn with faces(), and verts_uvn() has no UV.
+    // Throws std::invalid_argument if the level does not exist
+    void set_lod(size_t level);
+    // Level of detail set by set_lod
+    inline size_t lod() const { return _lod; }
+    // Triangles of the latest outputs: model.faces, or those of their
+    // level of detail
+    Eigen::Map<const Triangles> faces() const;
+
+    // Use cache for the pose blend shapes in update() (nullptr = off): if
+    // the pose is within cache->tolerance() of a cached pose, its offsets
+    // are reused and only the shape blend shapes and LBS are computed.
+    // Applies to the full mesh on CPU backends, with pose blend shapes
+    // enabled. The cache may be shared by bodies of any models; entries of
+    // each model (and load of it) are kept apart.
+    inline void set_pose_cache(std::shared_ptr<PoseCache> cache) {
+        _pose_cache = std::move(cache);
+    }
+    inline const std::shared_ptr<PoseCache>& pose_cache() const {
+        return _pose_cache;
+    }
+
+    // Personalize this body with per-vertex offsets (n_verts, 3), added to
+    // model.verts by update() before the blend shapes, e.g. SMPL+D
+    // displacements or a scanned template minus model.verts. Unlike
+    // Model::set_deformations the shared model is unchanged, so bodies of
+    // many subjects may use one model; the offsets may be shared by bodies
+    // of the same subject. nullptr = none.
+    // Throws std::invalid_argument if the size does not match the model
+    void set_template_offsets(std::shared_ptr<const Points> offsets);
+    // As above, copying offsets
+    void set_template_offsets(const Eigen::Ref<const Points>& offsets);
+    inline const std::shared_ptr<const Points>& template_offsets() const {
+        return _template_offsets;
+    }
+
+    // Sparse displacements, e.g. clothing or hair detail: offsets (#ids, 3)
+    // added by update() to the vertices vert_ids of the full mesh, in space
+    // (see DisplacementSpace). Canonical offsets are added to
+    // verts_shaped() and, skinned, to verts(); posed ones to verts() only.
+    // Neither moves the joints. Applying them costs O(#ids), so they may
+    // change every frame. With a CUDA backend, the outputs are then
+    // retrieved by update().
+    // Throws std::invalid_argument if sizes mismatch or an id is out of
+    // range
+    void set_displacements(const std::vector<Index>& vert_ids,
+                           const Eigen::Ref<const Points>& offsets,
+                           DisplacementSpace space =
+                               DisplacementSpace::canonical);
+    void clear_displacements();
+    inline const std::vector<Index>& displacement_ids() const {
+        return _disp_ids;
+    }
+    inline const Points& displacements() const { return _disp_offsets; }
+    inline DisplacementSpace displacement_space() const {
+        return _disp_space;
+    }
+
     // Save as obj file
     void save_obj(const std::string& path) const;
 
@@ -251,8 +642,11 @@ class Body {
                                 3 + 3 * model.n_explicit_joints() +
                                 model.n_hand_pca()));
     // Shape params
-    __SMPLX_MEMBER_ACCESSOR(
-        shape, params.template tail<ModelConfig::n_shape_blends()>());
+    // (model.n_shape_blends(), see Model::set_shape_space)
+    __SMPLX_MEMBER_ACCESSOR(shape, params.tail(model.n_shape_blends()));
+    // Expression params (SMPL-X), the last part of the shape params
+    __SMPLX_MEMBER_ACCESSOR(expression,
+                            params.tail(model.n_expression_blends()));
 
     // * OUTPUTS accessors
     // Get shaped + posed body vertices, in same order as model.verts;
@@ -279,6 +673,75 @@ class Body {
     const Eigen::Matrix<Scalar, Eigen::Dynamic, 12, Eigen::RowMajor>&
     vert_transforms() const;
 
+    // Get area-weighted unit vertex normals of the posed mesh, (n_verts, 3).
+    // Computed on first access after update(), unless already computed by
+    // update_normals(); must call update() before this is available.
+    // Like the other accessors, the reference is overwritten by later
+    // updates; other threads should read snapshot(true) instead
+    const Points& normals() const;
+
+    // Compute vertex normals of the posed mesh now, using up to n_threads
+    // threads of ThreadPool::global() (0 = all), unless already computed;
+    // must call update() first
+    void update_normals(size_t n_threads = 1);
+
+    // Get render-ready interleaved vertex data, one row per UV vertex
+    // (n_uv_verts, 8), to be drawn with model.uv_faces.
+    // Each row is position (3), UV (2), normal (3).
+    // If the model has no UV map, one row per vertex (n_verts, 8)
+    // with zero UV, to be drawn with model.faces.
+    // must call update() before this is available; see normals() for
+    // reading it from other threads
+    const PointsUVN& verts_uvn() const;
+
+    // Analytic Jacobian of outputs w.r.t. params at the latest update(),
+    // (3 * (#vert_ids + #joint_ids), n_params).
+    // Rows are x/y/z of verts()[vert_ids[0]], ..., then joints()[joint_ids[0]],
+    // ...; columns follow the layout of params.
+    // Sparse: a vertex only depends on the pose of the joints skinning it
+    // and their ancestors, unless pose_blendshapes is true, which includes
+    // the (dense) pose blend shape term; pass the enable_pose_blendshapes
+    // used in update() for the exact Jacobian.
+    // For products use J * v and J.transpose() * v.
+    SparseMatrix jacobian(const std::vector<Index>& vert_ids,
+                          const std::vector<Index>& joint_ids = {},
+                          bool pose_blendshapes = true) const;
+
+    // Outputs of one update(); see the accessors above
+    using Outputs = internal::BodyOutputs;
+
+    // Opt-in double buffering: update() writes a back buffer and then
+    // atomically publishes it, so other threads may read snapshot()s
+    // while this body updates. Published outputs are complete
+    // (retrieved from the backend, vertex transforms computed); normals()
+    // and verts_uvn() are cached with each buffer, so computing them for
+    // the front buffer does not race update().
+    void set_double_buffered(bool enable);
+    inline bool double_buffered() const { return _double_buffered; }
+
+    // Outputs of one update() with their normals() and verts_uvn()
+    struct Snapshot : Outputs {
+        // Valid only if requested from snapshot(); else they must not be
+        // read, as other threads may be computing them
+        Points normals;
+        PointsUVN verts_uvn;
+    };
+
+    // Stable, immutable snapshot of the latest outputs, with normals and
+    // verts_uvn if with_normals (computed unless cached). In
+    // double-buffered mode this is thread-safe w.r.t. update() and costs
+    // no copy (nor lock, without normals); else it copies the outputs and
+    // must not race with update().
+    std::shared_ptr<const Snapshot> snapshot(bool with_normals = false) const;
+
+    // Full pose (angle-axis, 3*#joints) from params, including hand
+    // joints computed from hand PCA
+    Vector full_pose() const;
+
+    // Host memory of this body by part (params, outputs, normals, ...);
+    // the model is not included (see Model::memory_usage)
+    MemoryUsage memory_usage() const;
+
     // Set parameters to zero
     inline void set_zero() { params.setZero(); }
 
@@ -293,65 +756,138 @@ class Body {
     Vector params;
 
    private:
-    // * OUTPUTS generated by update
-    // Deformed vertices (only shape applied); not available in case of GPU
-    // (only device.verts_shaped)
-    mutable Points _verts_shaped;
-
-    // Deformed vertices (shape and pose applied)
-    mutable Points _verts;
-
-    // Deformed joints (only shape applied)
-    Points _joints_shaped;
-
-    // Homogeneous transforms at each joint (bottom row omitted)
-    Eigen::Matrix<Scalar, Eigen::Dynamic, 12, Eigen::RowMajor>
-        _joint_transforms;
-
-    // Homogeneous transforms at each vertex (bottom row omitted)
-    mutable Eigen::Matrix<Scalar, Eigen::Dynamic, 12, Eigen::RowMajor>
-        _vert_transforms;
-
-    // Deformed joints (shape and pose applied)
-    mutable Points _joints;
-
-    // Transform local to global coordinates
-    // Inputs: trans(), _joints_shaped
-    // Outputs: _joints
-    // Input/output: _joint_transforms
-    void _local_to_global();
-
-#ifdef SMPLX_CUDA_ENABLED
-   public:
-    struct {
-        float* verts = nullptr;
-        float* verts_shaped = nullptr;
-        float* joints_shaped = nullptr;
-        // Internal temp
-        float* verts_tmp = nullptr;
-        // Internal (#total blend shapes) rm
-        float* blendshape_params = nullptr;
-        // Internal (#joints, 12) rm
-        float* joint_transforms = nullptr;
-    } device;
-
-   private:
-    // True if latest posed vertices constructed by update()
-    // have been retrieved to main memory
-    mutable bool _verts_retrieved;
-    // True if latest shaped, unposed vertices constructed by update()
-    // have been retrieved to main memory
-    mutable bool _verts_shaped_retrieved;
-    // True if last update made use of the GPU
-    bool _last_update_used_gpu;
-    // Cuda helpers
-    void _cuda_load();
-    void _cuda_free();
-    void _cuda_maybe_retrieve_verts() const;
-    void _cuda_maybe_retrieve_verts_shaped() const;
-    void _cuda_update(float* h_blendshape_params, float* h_joint_transforms,
-                      bool enable_pose_blendshapes = true);
-#endif
+    // Outputs of one update with the caches computed from them on demand,
+    // so each buffer of double buffering has its own
+    struct Buffer : Snapshot {
+        Buffer() = default;
+        Buffer(const Buffer& other) { *this = other; }
+        Buffer& operator=(const Buffer& other);
+
+        // Unnormalized face normals (length is twice the face area)
+        Points face_normals;
+        // True if normals is up to date with these outputs
+        std::atomic<bool> normals_computed{false};
+        // True if normals is up to date except around model.face_verts
+        // (after update_face)
+        bool normals_face_stale = false;
+        // True if verts_uvn is up to date with these outputs
+        std::atomic<bool> verts_uvn_computed{false};
+        // Full update these outputs derive from (see _n_updates), with
+        // update_face changing the face region only; 0 = none
+        uint64_t update_id = 0;
+    };
+
+    // * OUTPUTS generated by update, see accessors;
+    // verts and verts_shaped may live in the backend until retrieved.
+    // In double-buffered mode, this is the published (front) buffer and
+    // is only replaced atomically; always read through _front()
+    std::shared_ptr<Buffer> _out;
+    // Previous front buffer, reused as back buffer unless a snapshot of it
+    // is still held
+    std::shared_ptr<Buffer> _spare;
+    bool _double_buffered = false;
+    // Number of full updates so far, numbering their outputs
+    uint64_t _n_updates = 0;
+    // The front buffer
+    inline std::shared_ptr<Buffer> _front() const {
+        return std::atomic_load(&_out);
+    }
+    // Buffer to write the next outputs to: the front buffer, or in
+    // double-buffered mode the spare one unless a snapshot still holds it
+    std::shared_ptr<Buffer> _back_buffer();
+
+    // Lazily computed outputs are guarded by these flags and _cache_mtx,
+    // so const accessors may be called concurrently
+    mutable std::recursive_mutex _cache_mtx;
+    // True if verts/verts_shaped of _out were retrieved from the backend
+    mutable std::atomic<bool> _host_synced{true};
+    // True if _out->vert_transforms is up to date
+    mutable std::atomic<bool> _vert_transforms_ready{true};
+
+    // Run compute() under _cache_mtx unless ready, then set ready
+    template <class Func>
+    void _compute_once(std::atomic<bool>& ready, const Func& compute) const {
+        if (ready.load(std::memory_order_acquire)) return;
+        std::lock_guard<std::recursive_mutex> lock(_cache_mtx);
+        if (ready.load(std::memory_order_relaxed)) return;
+        compute();
+        ready.store(true, std::memory_order_release);
+    }
+    // Retrieve outputs from the backend if needed
+    void _sync_host() const;
+
+    // Backend set by set_backend
+    Backend _backend = Backend::automatic;
+    // Level of detail set by set_lod, and its data (null for level 0)
+    size_t _lod = 0;
+    std::shared_ptr<const LevelOfDetail> _lod_data;
+    // Pose blend shape cache set by set_pose_cache
+    std::shared_ptr<PoseCache> _pose_cache;
+    // Offsets set by set_template_offsets
+    std::shared_ptr<const Points> _template_offsets;
+    // Displacements set by set_displacements
+    std::vector<Index> _disp_ids;
+    Points _disp_offsets;
+    DisplacementSpace _disp_space = DisplacementSpace::canonical;
+    // True if the displacements changed since the latest full update
+    bool _disp_changed = false;
+    // Add the displacements to out, a full mesh output with complete
+    // verts and joint_transforms; if face_only, to model.face_verts only
+    void _displace(Outputs& out, bool face_only) const;
+    // Triangles and vertex-face adjacency of the level of detail of out
+    Eigen::Map<const Triangles> _faces(const Outputs& out) const;
+    Eigen::Map<const SparseMatrix> _vert_faces(const Outputs& out) const;
+    // State of the backend used in the latest update(), if any
+    std::unique_ptr<internal::BodyBackend<ModelConfig>> _backend_state;
+    // Type of _backend_state
+    Backend _backend_state_type = Backend::automatic;
+
+    // Completion of the latest update_async(), including its continuation
+    std::shared_future<void> _pending;
+    // Thread running the continuation of update_async(), if any
+    std::atomic<std::thread::id> _continuation_thread{};
+    // Outputs of the latest update_async() are ready
+    std::shared_future<void> _pending_outputs;
+    // Guards _pending and _pending_outputs, which update_async() replaces
+    // while other threads may wait on them
+    mutable std::mutex _pending_mtx;
+    inline std::shared_future<void> _load_future(
+        const std::shared_future<void>& future) const {
+        std::lock_guard<std::mutex> lock(_pending_mtx);
+        return future;
+    }
+    // Block until outputs of update_async() are ready
+    inline void _wait_outputs() const {
+        const std::shared_future<void> pending =
+            _load_future(_pending_outputs);
+        if (pending.valid()) pending.wait();
+    }
+    // update() without waiting for update_async()
+    void _update(bool force_cpu, bool enable_pose_blendshapes);
+
+    // Params and enable_pose_blendshapes of the latest full update; base of
+    // update_face
+    Vector _base_params;
+    bool _base_pose_blendshapes = false;
+    // Terms of the face region which update_face does not change:
+    // verts_shaped at model.face_verts without expression and face pose
+    // blend shapes (3*#face verts), and joints_shaped without expression
+    // (3*#joints). Valid if _face_cache_valid.
+    Vector _face_rest, _face_joints_rest;
+    bool _face_cache_valid = false;
+    // True if update_face may take the fast path
+    bool _can_update_face(bool enable_pose_blendshapes) const;
+
+    // Normals of out (host-synced), computed unless up to date
+    const Points& _normals(Buffer& out) const;
+    // Verts_uvn of out (host-synced), computed unless up to date
+    const PointsUVN& _verts_uvn(Buffer& out) const;
+    // Compute the face and vertex normals of out for the whole mesh
+    void _compute_normals(Buffer& out, size_t n_threads) const;
+    // Recompute normals of out around the given vertices only, assuming
+    // the rest of the mesh did not move since they were last computed
+    void _compute_normals_local(Buffer& out,
+                                const std::vector<Index>& moved_verts) const;
 };
 // SMPL Body
 using BodyS = Body<model_config::SMPL>;
@@ -0,0 +1,54 @@
+#pragma once
+#ifndef SMPLX_THREAD_POOL_2E6E93D3_C393_4125_9509_72CE30E970C8
+#define SMPLX_THREAD_POOL_2E6E93D3_C393_4125_9509_72CE30E970C8
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace smplx {
+
+/** Basic fixed-size worker pool used for the library's multithreaded paths.
+ *  Most code should use ThreadPool::global() rather than creating a pool. */
+class ThreadPool {
+   public:
+    // Create pool with n_threads workers; 0 = hardware concurrency
+    explicit ThreadPool(size_t n_threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Number of worker threads
+    inline size_t n_threads() const { return _workers.size(); }
+
+    // Enqueue a task to be run on some worker
+    void push(std::function<void()> task);
+
+    // Run func(begin, end) over chunks of [0, n), using up to n_threads
+    // threads including the calling thread (0 = all workers + caller).
+    // Blocks until all chunks are done. Safe to call from a worker.
+    void parallel_for(size_t n,
+                      const std::function<void(size_t, size_t)>& func,
+                      size_t n_threads = 0);
+
+    // Process-wide pool, created on first use
+    static ThreadPool& global();
+
+   private:
+    void _worker_loop();
+
+    std::vector<std::thread> _workers;
+    std::deque<std::function<void()>> _tasks;
+    std::mutex _mtx;
+    std::condition_variable _cv;
+    bool _stop = false;
+};
+
+}  // namespace smplx
+
+#endif  // ifndef SMPLX_THREAD_POOL_2E6E93D3_C393_4125_9509_72CE30E970C8
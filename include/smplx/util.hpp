@@ -4,6 +4,7 @@
 #include "smplx/defs.hpp"
 
 #include <random>
+#include <vector>
 
 #define _SMPLX_ASSERT(x)                                                 \
     do {                                                                 \
@@ -80,6 +81,11 @@ namespace util {
 const char* gender_to_str(Gender gender);
 Gender parse_gender(std::string str);  // Copy intended
 
+const char* backend_to_str(Backend backend);
+Backend parse_backend(std::string str);  // Copy intended
+// True if backend is compiled into this build
+bool backend_available(Backend backend);
+
 // Angle-axis to rotation matrix using custom implementation
 template <class T, int Option = Eigen::ColMajor>
 inline Eigen::Matrix<T, 3, 3, Option> rodrigues(
@@ -100,6 +106,35 @@ inline Eigen::Matrix<T, 3, 3, Option> rodrigues(
     }
 }
 
+// Cross product matrix: skew(v) * x = v.cross(x)
+template <class T, int Option = Eigen::ColMajor>
+inline Eigen::Matrix<T, 3, 3, Option> skew(
+    const Eigen::Ref<const Eigen::Matrix<T, 3, 1>>& v) {
+    Eigen::Matrix<T, 3, 3, Option> out;
+    out << 0, -v.z(), v.y(), v.z(), 0, -v.x(), -v.y(), v.x(), 0;
+    return out;
+}
+
+// Left Jacobian of the rodrigues map at angle-axis vec, in closed form:
+// d rodrigues(vec) / d vec[i] = skew(J.col(i)) * rodrigues(vec)
+template <class T, int Option = Eigen::ColMajor>
+inline Eigen::Matrix<T, 3, 3, Option> rodrigues_jacobian(
+    const Eigen::Ref<const Eigen::Matrix<T, 3, 1>>& vec) {
+    const T theta = vec.norm(), theta2 = theta * theta;
+    // a = (1 - cos t) / t^2, b = (t - sin t) / t^3; Taylor series near 0
+    // where the closed forms cancel catastrophically
+    T a, b;
+    if (theta < T(0.1)) {
+        a = T(1) / 2 - theta2 / 24 + theta2 * theta2 / 720;
+        b = T(1) / 6 - theta2 / 120 + theta2 * theta2 / 5040;
+    } else {
+        a = (1 - std::cos(theta)) / theta2;
+        b = (theta - std::sin(theta)) / (theta2 * theta);
+    }
+    const Eigen::Matrix<T, 3, 3, Option> k = skew<T, Option>(vec);
+    return Eigen::Matrix<T, 3, 3, Option>::Identity() + a * k + b * k * k;
+}
+
 // Angle-axis to rotation matrix through Eigen quaternion
 // (slightly slower than rodrigues, not useful)
 template <class T, int Option = Eigen::ColMajor>
@@ -138,6 +173,15 @@ inline void inv_homogeneous(Eigen::Ref<Eigen::Matrix<T, 3, 4, Option>> a) {
         -a.template leftCols<3>() * a.template rightCols<1>();
 }
 
+// Decimate a triangle mesh to about target_verts vertices by quadric error
+// half-edge collapses, so every kept vertex is an original vertex.
+// kept_verts: output, indices of the kept vertices (sorted)
+// out_faces: output, triangles indexing into kept_verts
+void decimate_mesh(const Points& verts,
+                   const Eigen::Ref<const Triangles>& faces,
+                   size_t target_verts, std::vector<Index>& kept_verts,
+                   Triangles& out_faces);
+
 // Path resolve helper: return a valid path to file in data/
 std::string find_data_file(const std::string& data_path);
 
@@ -147,6 +191,21 @@ Eigen::Vector3f auto_color(size_t color_index);
 // Create table of num_colors colors, shape (num_colors, 3) row-major
 Points auto_color_table(size_t num_colors);
 
+// Bytes of the coefficients of a dense matrix or map
+template <class Derived>
+inline size_t dense_bytes(const Eigen::DenseBase<Derived>& m) {
+    return m.size() * sizeof(typename Derived::Scalar);
+}
+
+// Bytes of the values and indices of a compressed sparse matrix or map
+template <class Derived>
+inline size_t sparse_bytes(const Eigen::SparseCompressedBase<Derived>& m) {
+    using StorageIndex = typename Derived::StorageIndex;
+    return m.nonZeros() *
+               (sizeof(typename Derived::Scalar) + sizeof(StorageIndex)) +
+           (m.outerSize() + 1) * sizeof(StorageIndex);
+}
+
 // Set matrix to iid multivariate normal
 template <class Mat>
 void set_randn(Mat& m, float mean = 0.0f, float variance = 1.0f) {
@@ -8,8 +8,8 @@
 namespace smplx {
 namespace util {
 
-// Matrix load helper; currently copies on return
-// can modify cnpy to load into the Eigen matrix; not important for now
+// Matrix load helper; copies on return. For large arrays, see
+// internal::NpzReader::load_into, which loads into the destination.
 Matrix load_float_matrix(const cnpy::NpyArray& raw, size_t r, size_t c);
 
 Eigen::Matrix<Index, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
@@ -9,38 +9,67 @@
 #include <Eigen/Geometry>
 #include <algorithm>
 #include <chrono>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
 
 #include "imfilebrowser.h"
 #include "meshview/meshview.hpp"
 #include "meshview/meshview_imgui.hpp"
+#include "smplx/model_registry.hpp"
 #include "smplx/sequence.hpp"
 #include "smplx/smplx.hpp"
 #include "smplx/util.hpp"
 
 using namespace smplx;
 
+// True if the default model of the gender is embedded or in data/, as
+// looked up by Model(gender)
+template <class ModelConfig>
+static bool model_exists(Gender gender) {
+    const std::string prefix =
+        std::string(ModelConfig::default_path_prefix) +
+        util::gender_to_str(gender);
+    const std::string name = prefix.substr(prefix.rfind('/') + 1);
+    for (const std::string& embedded : Model<ModelConfig>::embedded_names()) {
+        if (embedded == name) return true;
+    }
+    const std::string path = util::find_data_file(prefix);
+    return std::ifstream(path + ".smplxbin").good() ||
+           std::ifstream(path + ".npz").good();
+}
+
 template <class ModelConfig>
 static int run(std::string path) {
     SequenceAMASS amass(path);
     Gender gender = amass.gender;
 
     // * Construct SMPL body model
-    Model<ModelConfig> model(gender);
-    Body<ModelConfig> body(model);
+    auto& registry = ModelRegistry<ModelConfig>::global();
+    auto model = registry.get(gender);
+    std::unique_ptr<Body<ModelConfig>> body(new Body<ModelConfig>(*model));
+    // Load the other genders in the background, so opening a sequence of
+    // another gender does not wait on loading
+    for (Gender other : {Gender::neutral, Gender::male, Gender::female}) {
+        if (other != gender && model_exists<ModelConfig>(other)) {
+            registry.preload(other);
+        }
+    }
 
     if (amass.n_frames) {
         // If not empty, load shape/pose
-        amass.set_shape(body);
-        amass.set_pose(body, 0);
+        amass.set_shape(*body);
+        amass.set_pose(*body, 0);
     }
-    body.update();
+    body->update();
 
     // * Set up meshview viewer
     meshview::Viewer viewer;
 
     auto& smpl_mesh =
-        viewer.add_mesh(body.verts(), model.faces, 0.8f, 0.5f, 0.6f);
+        viewer.add_mesh(body->verts(), model->faces, 0.8f, 0.5f, 0.6f);
     // Due to different coordinate system, all AMASS dada are rotated 90 degs
     // CCW on x-axis; we undo this rotation using the model matrix
     smpl_mesh.rotate(
@@ -51,7 +80,7 @@ static int run(std::string path) {
     auto center_camera_on_human = [&]() {
         // Set camera's center of rotation to transformed root joint
         viewer.camera.center_of_rot = (/* model matrix */ smpl_mesh.transform *
-                                       /* deformed root joint */ body.joints()
+                                       /* deformed root joint */ body->joints()
                                            .row(0)
                                            .transpose()
                                            .homogeneous())
@@ -74,10 +103,10 @@ static int run(std::string path) {
     // Copy AMASS frame 'frame' to body and update mesh + (optionally) camera
     auto update_frame = [&]() {
         if (amass.n_frames == 0) return;  // Empty sequence
-        amass.set_pose(body, (size_t)frame);
-        body.update();
-        smpl_mesh.verts_pos().noalias() = body.verts();
-        smpl_mesh.faces.noalias() = model.faces;
+        amass.set_pose(*body, (size_t)frame);
+        body->update();
+        smpl_mesh.verts_pos().noalias() = body->verts();
+        smpl_mesh.faces.noalias() = model->faces;
         if (camera_follow_human) {
             // Follow the human with camera (set c.o.r. to root joint)
             center_camera_on_human();
@@ -146,8 +175,8 @@ static int run(std::string path) {
         ImGui::SetNextWindowPos(ImVec2(10, 10), ImGuiCond_Once);
         ImGui::SetNextWindowSize(ImVec2(300, 180), ImGuiCond_Once);
         ImGui::Begin("Control", NULL);
-        ImGui::Text("Model: %s  Gender: %s", model.name(),
-                    util::gender_to_str(model.gender));
+        ImGui::Text("Model: %s  Gender: %s", model->name(),
+                    util::gender_to_str(model->gender));
         if (amass.n_frames) {
             ImGui::TextWrapped("Seq: %s", path.c_str());
             ImGui::Text("Frame %i (%i total)", frame, (int)amass.n_frames);
@@ -189,13 +218,25 @@ static int run(std::string path) {
             // Load new sequence
             path = open_file_dialog.GetSelected().string();
             amass.load(path);
-            amass.set_shape(body);
-
             if (amass.gender != gender) {
-                // Have to change the gender
-                model.load(amass.gender);
-                gender = amass.gender;
+                // Have to change the gender; the model is shared and
+                // usually preloaded. Keep the current one if it fails.
+                try {
+                    if (!model_exists<ModelConfig>(amass.gender)) {
+                        throw std::runtime_error(
+                            std::string("no ") +
+                            util::gender_to_str(amass.gender) + " model");
+                    }
+                    model = registry.get(amass.gender);
+                    body.reset(new Body<ModelConfig>(*model));
+                    gender = amass.gender;
+                } catch (const std::exception& e) {
+                    std::cerr << "ERROR: Cannot load the model of " << path
+                              << " (" << e.what() << "), keeping the "
+                              << util::gender_to_str(gender) << " model\n";
+                }
             }
+            amass.set_shape(*body);
             open_file_dialog.ClearSelected();
             update_frame();
             viewer.loop_wait_events = true;
@@ -0,0 +1,74 @@
+// Converts a model .npz to .smplxbin, the memory-mappable binary model
+// format which loads without parsing (see Model::load / save_binary)
+// Usage: smplx-convert model_type input.npz output.smplxbin [uv.txt] [gender]
+// 1. model type
+//    options: S H X (SMPL SMPL-H SMPL-X)
+//    additional: S1 (SMPL v1.0) Xp (SMPLX with hand PCA) Z (SMPLX old v1.0)
+//    Zp (SMPLX v1.0 PCA)
+// 2. input .npz path
+// 3. output .smplxbin path
+// 4. optional UV map path (e.g. data/models/smplx/uv.txt), stored in the
+//    output
+// 5. optional gender recorded in the output: NEUTRAL MALE FEMALE
+// The output only loads into the same model type.
+#include <algorithm>
+#include <iostream>
+
+#include "smplx/smplx.hpp"
+#include "smplx/util.hpp"
+
+using namespace smplx;
+
+template <class ModelConfig>
+static int run(const std::string& in_path, const std::string& out_path,
+               const std::string& uv_path, Gender gender) {
+    _SMPLX_BEGIN_PROFILE;
+    Model<ModelConfig> model(in_path, uv_path, gender);
+    if (model.verts.rows() == 0) return 1;
+    _SMPLX_PROFILE(load npz);
+    model.save_binary(out_path);
+    _SMPLX_PROFILE(save);
+    Model<ModelConfig> check(out_path);
+    _SMPLX_PROFILE(load smplxbin);
+    if (check.verts != model.verts ||
+        check.blend_shapes != model.blend_shapes) {
+        std::cerr << "ERROR: converted model does not match\n";
+        return 1;
+    }
+    std::cout << "Wrote " << ModelConfig::model_name << " model to "
+              << out_path << "\n";
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        std::cerr << "Usage: " << argv[0]
+                  << " model_type input.npz output.smplxbin [uv.txt] "
+                     "[gender]\n"
+                     "model_type: S S1 H X Xp Z Zp\n";
+        return 1;
+    }
+    std::string model_name = argv[1];
+    const std::string uv_path = argc > 4 ? argv[4] : "";
+    const Gender gender =
+        argc > 5 ? util::parse_gender(argv[5]) : Gender::unknown;
+    for (auto& c : model_name) c = std::toupper(c);
+    if (model_name == "S") {
+        return run<model_config::SMPL>(argv[2], argv[3], uv_path, gender);
+    } else if (model_name == "S1") {
+        return run<model_config::SMPL_v1>(argv[2], argv[3], uv_path, gender);
+    } else if (model_name == "H") {
+        return run<model_config::SMPLH>(argv[2], argv[3], uv_path, gender);
+    } else if (model_name == "X") {
+        return run<model_config::SMPLX>(argv[2], argv[3], uv_path, gender);
+    } else if (model_name == "Z") {
+        return run<model_config::SMPLX_v1>(argv[2], argv[3], uv_path, gender);
+    } else if (model_name == "XP") {
+        return run<model_config::SMPLXpca>(argv[2], argv[3], uv_path, gender);
+    } else if (model_name == "ZP") {
+        return run<model_config::SMPLXpca_v1>(argv[2], argv[3], uv_path,
+                                              gender);
+    }
+    std::cerr << "Unknown model type '" << argv[1] << "'\n";
+    return 1;
+}
@@ -6,7 +6,8 @@
 //    PCA)
 // 2. model gender, default NEUTRAL
 //    options: NEUTRAL MALE FEMALE (case insensitive)
-// 3. cpu or gpu. default gpu (i.e. use gpu where available)
+// 3. compute backend: cpu, gpu or a backend name (cpu_reference cpu_simd
+//    cpu_parallel cuda). default automatic (i.e. use gpu where available)
 // 4. whether to enable pose blendshapes. on or off. default on
 //    note pose blendshapes are very slow.
 #include <algorithm>
@@ -21,11 +22,12 @@
 using namespace smplx;
 
 template <class ModelConfig>
-static int run(Gender gender, bool force_cpu, bool pose_blends) {
+static int run(Gender gender, Backend backend, bool pose_blends) {
     // * Construct SMPL body model
     Model<ModelConfig> model(gender);
+    model.set_backend(backend);
     Body<ModelConfig> body(model);
-    body.update(force_cpu, pose_blends);
+    body.update(false, pose_blends);
 
     // * Set up meshview viewer
     meshview::Viewer viewer;
@@ -79,7 +81,7 @@ static int run(Gender gender, bool force_cpu, bool pose_blends) {
 
     bool updated = false;
     auto update = [&]() {
-        body.update(force_cpu, pose_blends);
+        body.update(false, pose_blends);
         smpl_mesh.verts_pos().noalias() = body.verts();
         // Update the mesh on-the-fly (send to GPU)
         smpl_mesh_lbs.verts_pos().noalias() = body.verts();
@@ -277,23 +279,29 @@ int main(int argc, char** argv) {
         return 0;
     }
     Gender gender = util::parse_gender(argc > 2 ? argv[2] : "NEUTRAL");
-    bool force_cpu = argc > 3 ? (std::string(argv[3]) == "cpu") : false;
+    Backend backend =
+        argc > 3 ? util::parse_backend(argv[3]) : Backend::automatic;
+    if (!util::backend_available(backend)) {
+        std::cerr << "WARNING: backend " << util::backend_to_str(backend)
+                  << " is not available, using automatic\n";
+        backend = Backend::automatic;
+    }
     bool pose_blends = argc > 4 ? (std::string(argv[4]) != "off") : true;
     std::string model_name = argv[1];
     for (auto& c : model_name) c = std::toupper(c);
     if (argc < 2 || model_name == "S") {
-        return run<model_config::SMPL>(gender, force_cpu, pose_blends);
+        return run<model_config::SMPL>(gender, backend, pose_blends);
     } else if (model_name == "S1") {
-        return run<model_config::SMPL_v1>(gender, force_cpu, pose_blends);
+        return run<model_config::SMPL_v1>(gender, backend, pose_blends);
     } else if (model_name == "H") {
-        return run<model_config::SMPLH>(gender, force_cpu, pose_blends);
+        return run<model_config::SMPLH>(gender, backend, pose_blends);
     } else if (model_name == "X") {
-        return run<model_config::SMPLX>(gender, force_cpu, pose_blends);
+        return run<model_config::SMPLX>(gender, backend, pose_blends);
     } else if (model_name == "Z") {
-        return run<model_config::SMPLX_v1>(gender, force_cpu, pose_blends);
+        return run<model_config::SMPLX_v1>(gender, backend, pose_blends);
     } else if (model_name == "Xp") {
-        return run<model_config::SMPLXpca>(gender, force_cpu, pose_blends);
+        return run<model_config::SMPLXpca>(gender, backend, pose_blends);
     } else if (model_name == "Zp") {
-        return run<model_config::SMPLXpca_v1>(gender, force_cpu, pose_blends);
+        return run<model_config::SMPLXpca_v1>(gender, backend, pose_blends);
     }
 }
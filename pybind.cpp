@@ -2,24 +2,28 @@
 #include <pybind11/numpy.h>
 #include <pybind11/eigen.h>
 #include <pybind11/stl.h>
+#include <functional>
 #include <iostream>
 #include <string>
 
 #include <smplx/smplx.hpp>
 #include <smplx/sequence.hpp>
 #include <smplx/util.hpp>
+#include <smplx/internal/cpu_kernels.hpp>
 
 namespace py = pybind11;
 using namespace smplx;
 
 namespace {
-const bool CUDA_AVAILABLE =
-#ifdef SMPLX_CUDA_ENABLED
-    true
-#else
-    false
-#endif
-    ;
+// Getter of a lazily loaded Model member, loading its component first
+template <class ModelClass, class T>
+std::function<const T&(const ModelClass&)> lazy_member(
+    T ModelClass::*member, ModelComponent component) {
+    return [member, component](const ModelClass& model) -> const T& {
+        model.require(component);
+        return model.*member;
+    };
+}
 
 template <class ModelConfig>
 void declare_model(py::module& m, const std::string& py_model_name,
@@ -36,13 +40,110 @@ void declare_model(py::module& m, const std::string& py_model_name,
         .def("load",
              py::overload_cast<const std::string&, const std::string&, Gender>(
                  &ModelClass::load),
-             "Load npz model", py::arg("path"), py::arg("uv_path") = "",
-             py::arg("gender") = Gender::unknown)
+             "Load npz (or .smplxbin) model", py::arg("path"),
+             py::arg("uv_path") = "", py::arg("gender") = Gender::unknown)
+        .def("save_binary", &ModelClass::save_binary,
+             "Save model data as .smplxbin, a memory-mapped binary format "
+             "which load() reads without parsing",
+             py::arg("path"))
+        .def("publish_shared", &ModelClass::publish_shared,
+             "Publish the model data in the named POSIX shared memory "
+             "segment (e.g. '/smplx_neutral'), replacing any previous one",
+             py::arg("name"))
+        .def("load_shared", &ModelClass::load_shared,
+             "Load from a shared memory segment published by any process; "
+             "the data is shared read-only, not copied. Returns True if "
+             "counted in shared_info (the segment is writable by this "
+             "process)",
+             py::arg("name"))
+        .def("load_embedded", &ModelClass::load_embedded,
+             "Load a model compiled into the library (SMPLX_EMBED_MODELS), "
+             "by file name without extension, e.g. 'SMPLX_NEUTRAL'",
+             py::arg("name"))
+        .def("require",
+             py::overload_cast<ModelComponent>(&ModelClass::require,
+                                               py::const_),
+             "Load a component of a model loaded from npz now rather than "
+             "on first use",
+             py::arg("component"))
+        .def("preload", &ModelClass::preload,
+             "Load all components now rather than on first use")
+        .def("is_loaded", &ModelClass::is_loaded,
+             "True if the component is loaded", py::arg("component"))
+        .def("memory_usage", &ModelClass::memory_usage,
+             "Host memory of the model data by part, counting loaded "
+             "components only")
+        .def_property("huge_pages", &ModelClass::huge_pages,
+                      &ModelClass::set_huge_pages,
+                      "Page backing of blend_shapes (HugePages); set before "
+                      "creating bodies")
+        .def("warmup", &ModelClass::warmup,
+             py::call_guard<py::gil_scoped_release>(),
+             py::arg("lock_memory") = false,
+             "Load all components, fault in (and optionally mlock) the "
+             "data read by updates, and run one update per backend")
+        .def_static("unlink_shared", &ModelClass::unlink_shared,
+                    "Remove the named shared memory segment; False if it "
+                    "did not exist",
+                    py::arg("name"))
+        .def_static("embedded_names", &ModelClass::embedded_names,
+                    "Names of the models compiled into the library")
+        .def_static(
+            "shared_info",
+            [](const std::string& name) {
+                const auto info = ModelClass::shared_info(name);
+                py::dict result;
+                result["generation"] = info.generation;
+                result["n_attached"] = info.n_attached;
+                result["size"] = info.size;
+                return result;
+            },
+            "Generation, number of attached models (across processes) and "
+            "size in bytes of the named shared memory segment",
+            py::arg("name"))
         .def("set_deformations", &ModelClass::set_deformations,
              "Set template deformations: verts := verts_init + deform",
              py::arg("deform") = Gender::unknown)
         .def("set_template", &ModelClass::set_template,
              "Set base template: verts := template")
+        .def("set_shape_space", &ModelClass::set_shape_space,
+             "Keep only the first n_body_shape shape and n_expression "
+             "expression blend shapes, now and in later loads; create "
+             "bodies after this",
+             py::arg("n_body_shape"), py::arg("n_expression") = 0)
+        .def("add_lod", py::overload_cast<size_t>(&ModelClass::add_lod),
+             py::arg("target_verts"),
+             "Add a level of detail by decimating the mesh to about "
+             "target_verts vertices; returns its level (see Body.lod)")
+        .def("add_lod",
+             py::overload_cast<const std::vector<Index>&, const Triangles&>(
+                 &ModelClass::add_lod),
+             py::arg("vert_ids"), py::arg("faces"),
+             "Add a level of detail from a vertex subset and triangles "
+             "indexing into it; returns its level")
+        .def("clear_lods", &ModelClass::clear_lods,
+             "Remove all levels of detail")
+        .def_property_readonly("n_lods", &ModelClass::n_lods,
+                               "Number of levels of detail, including the "
+                               "full mesh (level 0)")
+        .def(
+            "lod_vert_ids",
+            [](const ModelClass& obj, size_t level) {
+                return obj.lod(level).vert_ids;
+            },
+            py::arg("level"), "Model vertex of each vertex of a level >= 1")
+        .def(
+            "lod_faces",
+            [](const ModelClass& obj, size_t level) -> const Triangles& {
+                return obj.lod(level).faces;
+            },
+            py::return_value_policy::reference_internal, py::arg("level"),
+            "Triangles of a level of detail >= 1")
+        .def_property("backend", &ModelClass::backend,
+                      &ModelClass::set_backend,
+                      "Compute backend used by bodies of this model which "
+                      "do not set their own; raises ValueError if not "
+                      "available")
         .def_property_readonly_static(
             "n_verts",
             [](const py::object& obj) { return ModelClass::n_verts(); },
@@ -55,18 +156,19 @@ void declare_model(py::module& m, const std::string& py_model_name,
             "n_faces",
             [](const py::object& obj) { return ModelClass::n_faces(); },
             "Number of faces in mesh")
-        .def_property_readonly_static(
-            "n_blend_shapes",
-            [](const py::object& obj) { return ModelClass::n_blend_shapes(); },
-            "Total number of blend shapes")
+        .def_property_readonly("n_blend_shapes", &ModelClass::n_blend_shapes,
+                               "Total number of blend shapes")
         .def_property_readonly_static(
             "n_pose_blends",
             [](const py::object& obj) { return ModelClass::n_pose_blends(); },
             "Number of pose blend shapes (9 * n_joints)")
-        .def_property_readonly_static(
-            "n_shape_blends",
-            [](const py::object& obj) { return ModelClass::n_shape_blends(); },
-            "Number of shape blend shapes")
+        .def_property_readonly("n_shape_blends", &ModelClass::n_shape_blends,
+                               "Number of shape blend shapes (see "
+                               "set_shape_space)")
+        .def_property_readonly(
+            "n_expression_blends", &ModelClass::n_expression_blends,
+            "Number of expression blend shapes, the end of the shape blend "
+            "shapes")
         .def_property_readonly_static(
             "n_hand_pca",
             [](const py::object& obj) { return ModelClass::n_hand_pca(); },
@@ -85,10 +187,8 @@ void declare_model(py::module& m, const std::string& py_model_name,
             },
             "Number of hand pca joints (joints controlled using hand PCA "
             "rather than using rotations)")
-        .def_property_readonly_static(
-            "n_params",
-            [](const py::object& obj) { return ModelClass::n_params(); },
-            "Total number of model parameters")
+        .def_property_readonly("n_params", &ModelClass::n_params,
+                               "Total number of model parameters")
         .def_property_readonly_static(
             "name", [](const py::object& obj) { return ModelClass::name(); },
             "Model name")
@@ -109,40 +209,75 @@ void declare_model(py::module& m, const std::string& py_model_name,
                       "Unposed vertices (alias)")
         .def_readonly("joints", &ModelClass::joints, "Unposed joints")
         .def_readonly("faces", &ModelClass::faces, "Triangular faces")
+        .def_property_readonly(
+            "vert_faces",
+            [](const ModelClass& obj) { return SparseMatrix(obj.vert_faces); },
+            "Vertex-face adjacency sparse matrix (n_verts, n_faces)")
         .def_readonly("joint_reg", &ModelClass::joint_reg,
                       "Joint regressor sparsematrix (n_joints, n_verts)")
+        .def_property_readonly(
+            "joint_shape_blends",
+            lazy_member(&ModelClass::joint_shape_blends,
+                        ModelComponent::shape_blends),
+            "Shape blend shapes of the joints "
+            "(3 * n_joints, n_shape_blends) colmajor")
         .def_readonly("weights", &ModelClass::weights,
                       "LBS weights sparse matrix (n_verts, n_joints)")
-        .def_readonly("blend_shapes", &ModelClass::blend_shapes,
-                      "Shape and pose blend shapes "
-                      "(3 * n_verts, n_shape_blends + n_pose_blends) colmajor;"
-                      "each column is (n_verts, 3) rowmajor")
+        .def_property_readonly(
+            "face_verts",
+            lazy_member(&ModelClass::face_verts, ModelComponent::face_region),
+            "Vertices moved by expression and face joint pose "
+            "(see Body.update_face); empty if no face region")
+        .def_property_readonly(
+            "blend_shapes",
+            [](const ModelClass& model) -> const auto& {
+                model.require(ModelComponent::shape_blends);
+                model.require(ModelComponent::pose_blends);
+                return model.blend_shapes;
+            },
+            "Shape and pose blend shapes "
+            "(3 * n_verts, n_shape_blends + n_pose_blends) colmajor;"
+            "each column is (n_verts, 3) rowmajor")
         .def_property_readonly(
             "has_hand_pca",
             [](const py::object& _) { return ModelConfig::n_hand_pca() > 0; },
             "True if hand PCA is available")
-        .def_readonly("hand_comps_l", &ModelClass::hand_comps_l,
-                      "Principal components for left hand (3 * "
-                      "n_hand_pca_joints, n_hand_pca). "
-                      "Available if has_hand_pca")
-        .def_readonly("hand_comps_r", &ModelClass::hand_comps_r,
-                      "Principal components for right hand (3 * "
-                      "n_hand_pca_joints, n_hand_pca). "
-                      "Available if has_hand_pca")
-        .def_readonly("hand_mean_l", &ModelClass::hand_mean_l,
-                      "Mean parameters for left hand (3 * "
-                      "n_hand_pca_joints). "
-                      "Available if has_hand_pca")
-        .def_readonly("hand_mean_r", &ModelClass::hand_mean_r,
-                      "Mean parameters for right hand (3 * "
-                      "n_hand_pca_joints). "
-                      "Available if has_hand_pca")
-        .def_readonly("uv", &ModelClass::uv,
-                      "Texture coords (n_uv_verts, 2). "
-                      "Available if has_uv_map")
-        .def_readonly(
-            "uv_faces", &ModelClass::uv_faces,
+        .def_property_readonly(
+            "hand_comps_l",
+            lazy_member(&ModelClass::hand_comps_l, ModelComponent::hand_pca),
+            "Principal components for left hand (3 * "
+            "n_hand_pca_joints, n_hand_pca). "
+            "Available if has_hand_pca")
+        .def_property_readonly(
+            "hand_comps_r",
+            lazy_member(&ModelClass::hand_comps_r, ModelComponent::hand_pca),
+            "Principal components for right hand (3 * "
+            "n_hand_pca_joints, n_hand_pca). "
+            "Available if has_hand_pca")
+        .def_property_readonly(
+            "hand_mean_l",
+            lazy_member(&ModelClass::hand_mean_l, ModelComponent::hand_pca),
+            "Mean parameters for left hand (3 * "
+            "n_hand_pca_joints). "
+            "Available if has_hand_pca")
+        .def_property_readonly(
+            "hand_mean_r",
+            lazy_member(&ModelClass::hand_mean_r, ModelComponent::hand_pca),
+            "Mean parameters for right hand (3 * "
+            "n_hand_pca_joints). "
+            "Available if has_hand_pca")
+        .def_property_readonly(
+            "uv", lazy_member(&ModelClass::uv, ModelComponent::uv_map),
+            "Texture coords (n_uv_verts, 2). Available if has_uv_map")
+        .def_property_readonly(
+            "uv_faces",
+            lazy_member(&ModelClass::uv_faces, ModelComponent::uv_map),
             "Texture coord faces (n_faces, 3). Available if has_uv_map")
+        .def_property_readonly(
+            "uv_to_vert",
+            lazy_member(&ModelClass::uv_to_vert, ModelComponent::uv_map),
+            "Mesh vertex index of each texture coord (n_uv_verts). "
+            "Available if has_uv_map")
         .def("__repr__", [](const ModelClass& obj) {
             return std::string("<smplxpp.Model(name=") + obj.name() +
                    ", gender=" + util::gender_to_str(obj.gender) +
@@ -167,16 +302,76 @@ void declare_model(py::module& m, const std::string& py_model_name,
         Eigen::Ref<Eigen::Matrix<Scalar, ModelConfig::n_hand_pca(), 1>>;
     using HandPCAHalfConstRefType =
         Eigen::Ref<const Eigen::Matrix<Scalar, ModelConfig::n_hand_pca(), 1>>;
-    using ShapeRefType =
-        Eigen::Ref<Eigen::Matrix<Scalar, ModelConfig::n_shape_blends(), 1>>;
-    using ShapeConstRefType = Eigen::Ref<
-        const Eigen::Matrix<Scalar, ModelConfig::n_shape_blends(), 1>>;
+    // Sized by the model's shape space
+    using ShapeRefType = Eigen::Ref<Vector>;
+    using ShapeConstRefType = Eigen::Ref<const Vector>;
+    using ExprRefType = Eigen::Ref<Vector>;
+    using ExprConstRefType = Eigen::Ref<const Vector>;
 
     py::class_<BodyClass>(m, py_body_name.c_str())
         .def(py::init<const ModelClass&, bool>(), py::arg("model"),
              py::arg("set_zero") = true)
         .def("update", &BodyClass::update, py::arg("force_cpu") = false,
              py::arg("enable_pose_blendshapes") = true)
+        .def("update_face", &BodyClass::update_face,
+             py::arg("enable_pose_blendshapes") = true,
+             "Like update(), but only recomputes the face region if only "
+             "expression and jaw/eye pose changed since the last update. "
+             "Returns True if this fast path was taken")
+        .def(
+            "update_async",
+            [](BodyClass& obj, bool force_cpu, bool enable_pose_blendshapes) {
+                obj.update_async(force_cpu, enable_pose_blendshapes);
+            },
+            py::arg("force_cpu") = false,
+            py::arg("enable_pose_blendshapes") = true,
+            "Run update() on the library's worker pool and return "
+            "immediately; outputs block until ready. Do not modify params "
+            "until wait() returns")
+        .def("wait", &BodyClass::wait,
+             py::call_guard<py::gil_scoped_release>(),
+             "Wait for the latest update_async()")
+        .def_property("lod", &BodyClass::lod, &BodyClass::set_lod,
+                      "Level of detail evaluated by update(), 0 = full mesh; "
+                      "see Model.add_lod")
+        .def_property_readonly("faces", &BodyClass::faces,
+                               "Triangles of the latest outputs (those of "
+                               "their level of detail)")
+        .def_property("pose_cache", &BodyClass::pose_cache,
+                      &BodyClass::set_pose_cache,
+                      "PoseCache used by update() for the pose blend shapes, "
+                      "or None")
+        .def_property(
+            "template_offsets",
+            [](const BodyClass& obj) -> py::object {
+                if (!obj.template_offsets()) return py::none();
+                return py::cast(*obj.template_offsets());
+            },
+            [](BodyClass& obj, py::object offsets) {
+                if (offsets.is_none()) {
+                    obj.set_template_offsets(nullptr);
+                } else {
+                    obj.set_template_offsets(offsets.cast<Points>());
+                }
+            },
+            "Per-vertex offsets (n_verts, 3) added to model.verts by "
+            "update(), personalizing this body without changing the model, "
+            "or None")
+        .def("set_displacements", &BodyClass::set_displacements,
+             py::arg("vert_ids"), py::arg("offsets"),
+             py::arg("space") = DisplacementSpace::canonical,
+             "Sparse displacements: offsets (len(vert_ids), 3) added by "
+             "update() to vertices vert_ids, before skinning (canonical) or "
+             "after (posed). Raises ValueError on bad sizes or ids")
+        .def("clear_displacements", &BodyClass::clear_displacements,
+             "Remove the displacements")
+        .def_property("double_buffered", &BodyClass::double_buffered,
+                      &BodyClass::set_double_buffered,
+                      "If true, update() writes into a spare output buffer "
+                      "and publishes it atomically when done")
+        .def_property("backend", &BodyClass::backend, &BodyClass::set_backend,
+                      "Compute backend used by update(); automatic = use "
+                      "the model's. Raises ValueError if not available")
         .def_property_readonly("verts", &BodyClass::verts,
                                "Posed vertices, available after update() call")
         .def_property_readonly(
@@ -200,6 +395,27 @@ void declare_model(py::module& m, const std::string& py_model_name,
             "Vertex transforms. Each row is a row-major (3,4) "
             "rigid body transform matrix, bottom row "
             "omitted. Available after update() call")
+        .def_property_readonly(
+            "normals", &BodyClass::normals,
+            "Area-weighted unit vertex normals of posed mesh (n_verts, 3). "
+            "Available after update() call")
+        .def("update_normals", &BodyClass::update_normals,
+             "Compute vertex normals now, using n_threads threads "
+             "(0 = all)",
+             py::arg("n_threads") = 1)
+        .def_property_readonly(
+            "verts_uvn", &BodyClass::verts_uvn,
+            "Render-ready vertex data (n_uv_verts, 8), each row is position "
+            "(3), UV (2), normal (3); draw with model.uv_faces. If model has "
+            "no UV map, (n_verts, 8) with zero UV; draw with model.faces. "
+            "Available after update() call")
+        .def("jacobian", &BodyClass::jacobian, py::arg("vert_ids"),
+             py::arg("joint_ids") = std::vector<Index>(),
+             py::arg("pose_blendshapes") = true,
+             "Analytic Jacobian (scipy.sparse CSR) of verts[vert_ids] then "
+             "joints[joint_ids], 3 rows each, w.r.t. params, at the latest "
+             "update(). Pass the enable_pose_blendshapes used in update() "
+             "for the exact Jacobian")
         .def_property_readonly(
             "model",
             [](const BodyClass& obj) -> const ModelClass& { return obj.model; },
@@ -258,6 +474,14 @@ void declare_model(py::module& m, const std::string& py_model_name,
                 obj.shape() = val;
             },
             "Shape part of parameters vector (n_shape_blends) alias of shape")
+        .def_property(
+            "expression",
+            [](BodyClass& obj) -> ExprRefType { return obj.expression(); },
+            [](BodyClass& obj, const ExprConstRefType& val) {
+                obj.expression() = val;
+            },
+            "Expression part of parameters vector (n_expression_blends), "
+            "the end of shape")
         .def("set_zero", &BodyClass::set_zero, "Set all parameters to 0")
         .def("set_random", &BodyClass::set_random,
              "Set all parameters u.a.r. in  [-0.25, 0.25]. Maybe not "
@@ -266,6 +490,8 @@ void declare_model(py::module& m, const std::string& py_model_name,
              "distribution.")
         .def("save_obj", &BodyClass::save_obj,
              "Save a basic OBJ file from the posed model (call update first)")
+        .def("memory_usage", &BodyClass::memory_usage,
+             "Host memory of the body by part, excluding the model")
         .def("__repr__", [](const BodyClass& obj) {
             return std::string("<smplxpp.Body(name=") + obj.model.name() +
                    ", gender=" + util::gender_to_str(obj.model.gender) +
@@ -373,12 +599,54 @@ void batch_inv_homogeneous(
 PYBIND11_MODULE(smplxpp, m) {
     m.doc() =
         R"pbdoc(SMPLXpp: SMPL/SMPL+H/SMPL-X implementation as C++ extension)pbdoc";
-    m.attr("cuda") = CUDA_AVAILABLE;
+    m.attr("cuda") = util::backend_available(Backend::cuda);
     py::enum_<Gender>(m, "Gender")
         .value("unknown", Gender::unknown)
         .value("neutral", Gender::neutral)
         .value("female", Gender::female)
         .value("male", Gender::male);
+    py::enum_<Backend>(m, "Backend")
+        .value("automatic", Backend::automatic)
+        .value("cpu_reference", Backend::cpu_reference)
+        .value("cpu_simd", Backend::cpu_simd)
+        .value("cpu_parallel", Backend::cpu_parallel)
+        .value("cuda", Backend::cuda);
+    py::enum_<ModelComponent>(m, "ModelComponent")
+        .value("shape_blends", ModelComponent::shape_blends)
+        .value("pose_blends", ModelComponent::pose_blends)
+        .value("hand_pca", ModelComponent::hand_pca)
+        .value("uv_map", ModelComponent::uv_map)
+        .value("face_region", ModelComponent::face_region);
+    py::enum_<DisplacementSpace>(m, "DisplacementSpace")
+        .value("canonical", DisplacementSpace::canonical)
+        .value("posed", DisplacementSpace::posed);
+    py::enum_<HugePages>(m, "HugePages")
+        .value("off", HugePages::off)
+        .value("transparent", HugePages::transparent)
+        .value("reserved", HugePages::reserved);
+    py::class_<MemoryUsage>(m, "MemoryUsage")
+        .def_readonly("parts", &MemoryUsage::parts, "Bytes of each part")
+        .def_property_readonly("total", &MemoryUsage::total, "Total bytes")
+        .def("__repr__", [](const MemoryUsage& obj) {
+            return "<smplxpp.MemoryUsage(total=" +
+                   std::to_string(obj.total()) + ")>";
+        });
+    py::class_<PoseCache, std::shared_ptr<PoseCache>>(m, "PoseCache")
+        .def(py::init<size_t, Scalar>(), py::arg("capacity") = 256,
+             py::arg("tolerance") = 1e-2f,
+             "Approximate LRU cache of pose blend shape offsets; tolerance "
+             "is the max rotation difference per joint (radians) for a hit. "
+             "Share between bodies with Body.pose_cache")
+        .def("clear", &PoseCache::clear, "Remove all entries")
+        .def("reset_stats", &PoseCache::reset_stats,
+             "Reset hit/miss counters")
+        .def_property_readonly("size", &PoseCache::size, "Number of entries")
+        .def_property_readonly("capacity", &PoseCache::capacity,
+                               "Max number of entries")
+        .def_property_readonly("tolerance", &PoseCache::tolerance,
+                               "Max rotation difference per joint (radians)")
+        .def_property_readonly("hits", &PoseCache::hits, "Lookup hits")
+        .def_property_readonly("misses", &PoseCache::misses, "Lookup misses");
     declare_model<model_config::SMPL>(m, "ModelS", "BodyS");
     declare_model<model_config::SMPLH>(m, "ModelH", "BodyH");
     declare_model<model_config::SMPLX>(m, "ModelX", "BodyX");
@@ -407,6 +675,15 @@ PYBIND11_MODULE(smplxpp, m) {
              "Rigid-body transform in-place inversion in a batch. Input (n, "
              "12) (each row is "
              "3x4 row-major)")
+        .def(
+            "cpu_isa",
+            []() { return std::string(internal::cpu_kernels().name); },
+            "Instruction set of the CPU kernels in use (scalar/avx2/avx512); "
+            "set env var SMPLX_CPU_ISA before import to force one")
         .def("gender_to_str", &util::gender_to_str, "Gender enum to string")
-        .def("parse_gender", &util::parse_gender, "Gender enum from string");
+        .def("parse_gender", &util::parse_gender, "Gender enum from string")
+        .def("backend_to_str", &util::backend_to_str, "Backend enum to string")
+        .def("parse_backend", &util::parse_backend, "Backend enum from string")
+        .def("backend_available", &util::backend_available,
+             "True if backend is available in this build");
 }
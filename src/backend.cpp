@@ -0,0 +1,364 @@
+#include "smplx/internal/backend.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "smplx/internal/cpu_kernels.hpp"
+#include "smplx/pose_cache.hpp"
+#include "smplx/smplx.hpp"
+#include "smplx/thread_pool.hpp"
+#include "smplx/util.hpp"
+
+namespace smplx {
+namespace internal {
+namespace {
+
+using TransformMap = Eigen::Map<Eigen::Matrix<Scalar, 3, 4, Eigen::RowMajor>>;
+using TransformTransposedMap = Eigen::Map<Eigen::Matrix<Scalar, 4, 3>>;
+using RotationMap = Eigen::Map<Eigen::Matrix<Scalar, 3, 3, Eigen::RowMajor>>;
+
+// Minimum rows/vertices per task in cpu_parallel; smaller ranges are not
+// worth the synchronization
+const size_t PARALLEL_MIN_GRAIN = 4096;
+
+// Run func over [0, n), split across the global pool if parallel
+template <class Func>
+void run_range(bool parallel, size_t n, const Func& func) {
+    if (!parallel || n < 2 * PARALLEL_MIN_GRAIN) {
+        func(0, n);
+        return;
+    }
+    auto& pool = ThreadPool::global();
+    const size_t max_threads = n / PARALLEL_MIN_GRAIN;
+    pool.parallel_for(n, func, std::min(max_threads, pool.n_threads() + 1));
+}
+
+/** CPU backends. cpu_reference is the plain Eigen implementation;
+ *  cpu_simd and cpu_parallel use the runtime-dispatched kernels,
+ *  the latter splitting rows/vertices across ThreadPool::global() */
+template <class ModelConfig>
+class CpuBodyBackend : public BodyBackend<ModelConfig> {
+   public:
+    CpuBodyBackend(const Model<ModelConfig>& model, Backend type)
+        : model(model),
+          type(type),
+          blendshape_params(model.n_blend_shapes()) {}
+
+    void update(const Vector& full_pose, const Eigen::Ref<const Vector>& shape,
+                const Eigen::Ref<const Vector3f>& trans,
+                const Points* template_offsets, bool enable_pose_blendshapes,
+                BodyOutputs& out) override {
+        const bool reference = type == Backend::cpu_reference;
+        const bool parallel = type == Backend::cpu_parallel;
+        const auto& kernels = cpu_kernels();
+        out.verts_shaped.resize(model.n_verts(), 3);
+        out.verts.resize(model.n_verts(), 3);
+        out.joint_transforms.resize(model.n_joints(), 12);
+
+        // Copy shape params to blendshape params
+        blendshape_params.resize(model.n_blend_shapes());
+        blendshape_params.head(model.n_shape_blends()) = shape;
+
+        // Convert angle-axis to rotation matrix using rodrigues
+        if (reference) {
+            for (size_t i = 0; i < model.n_joints(); ++i) {
+                TransformMap(out.joint_transforms.row(i).data())
+                    .template leftCols<3>()
+                    .noalias() =
+                    util::rodrigues<float>(full_pose.segment<3>(3 * i));
+            }
+        } else {
+            kernels.rodrigues(full_pose.data(), out.joint_transforms.data(),
+                              model.n_joints());
+        }
+        // Pose blend shape params: R - I of each non-root joint
+        for (size_t i = 1; i < model.n_joints(); ++i) {
+            TransformMap joint_trans(out.joint_transforms.row(i).data());
+            RotationMap mp(blendshape_params.data() + 9 * i +
+                           (model.n_shape_blends() - 9));
+            mp.noalias() = joint_trans.template leftCols<3>();
+            mp.diagonal().array() -= 1.f;
+        }
+
+        // Apply blend shapes
+        const size_t n_rows = model.n_verts() * 3;
+        Eigen::Map<Vector> verts_shaped_flat(out.verts_shaped.data(), n_rows);
+        auto blend = [&](size_t col_begin, size_t n_cols) {
+            if (reference) {
+                verts_shaped_flat.noalias() +=
+                    model.blend_shapes.middleCols(col_begin, n_cols) *
+                    blendshape_params.segment(col_begin, n_cols);
+                return;
+            }
+            run_range(parallel, n_rows, [&](size_t begin, size_t end) {
+                kernels.gemv(model.blend_shapes.data() + col_begin * n_rows,
+                             n_rows, blendshape_params.data() + col_begin,
+                             out.verts_shaped.data(), n_cols, begin, end);
+            });
+        };
+        out.verts_shaped.noalias() = model.verts;
+        if (template_offsets) out.verts_shaped.noalias() += *template_offsets;
+        // Add shape blend shapes
+        blend(0, model.n_shape_blends());
+
+        // Apply joint regressor
+        out.joints_shaped = model.joint_reg * out.verts_shaped;
+
+        if (enable_pose_blendshapes) {
+            // Add pose blend shapes; by far the most expensive step
+            blend(model.n_shape_blends(), model.n_pose_blends());
+        }
+
+        local_to_global<ModelConfig>(trans, out);
+
+        // * LBS *
+        // Construct a transform for each vertex and apply it
+        if (reference) {
+            out.vert_transforms.noalias() =
+                model.weights * out.joint_transforms;
+            for (size_t i = 0; i < model.n_verts(); ++i) {
+                TransformTransposedMap transform_tr(
+                    out.vert_transforms.row(i).data());
+                out.verts.row(i).noalias() =
+                    out.verts_shaped.row(i).homogeneous() * transform_tr;
+            }
+            return;
+        }
+        out.vert_transforms.resize(model.n_verts(), 12);
+        run_range(parallel, model.n_verts(), [&](size_t begin, size_t end) {
+            kernels.lbs(model.weights.outerIndexPtr(),
+                        model.weights.innerIndexPtr(),
+                        model.weights.valuePtr(), out.joint_transforms.data(),
+                        out.verts_shaped.data(), out.verts.data(),
+                        out.vert_transforms.data(), begin, end);
+        });
+    }
+
+   private:
+    const Model<ModelConfig>& model;
+    const Backend type;
+    // Shape params + pose blend shape params (R - I for each non-root joint,
+    // flattened row-major)
+    Vector blendshape_params;
+};
+
+template <class ModelConfig>
+class CpuModelBackend : public ModelBackend<ModelConfig> {
+   public:
+    CpuModelBackend(const Model<ModelConfig>& model, Backend type)
+        : ModelBackend<ModelConfig>(model), _type(type) {}
+
+    Backend type() const override { return _type; }
+
+    std::unique_ptr<BodyBackend<ModelConfig>> create_body() const override {
+        return std::unique_ptr<BodyBackend<ModelConfig>>(
+            new CpuBodyBackend<ModelConfig>(this->model, _type));
+    }
+
+   private:
+    const Backend _type;
+};
+
+}  // namespace
+
+template <class ModelConfig>
+std::unique_ptr<ModelBackend<ModelConfig>> create_model_backend(
+    const Model<ModelConfig>& model, Backend backend) {
+    switch (backend) {
+        case Backend::cpu_reference:
+        case Backend::cpu_simd:
+        case Backend::cpu_parallel:
+            return std::unique_ptr<ModelBackend<ModelConfig>>(
+                new CpuModelBackend<ModelConfig>(model, backend));
+        case Backend::cuda:
+#ifdef SMPLX_CUDA_ENABLED
+            return create_cuda_model_backend<ModelConfig>(model);
+#endif
+        default:
+            return nullptr;
+    }
+}
+
+Backend resolve_backend(Backend body_backend, Backend model_backend) {
+    if (body_backend != Backend::automatic) return body_backend;
+    if (model_backend != Backend::automatic) return model_backend;
+    return util::backend_available(Backend::cuda) ? Backend::cuda
+                                                  : Backend::cpu_simd;
+}
+
+template <class ModelConfig>
+void update_lod(const Model<ModelConfig>& model, size_t level,
+                const std::shared_ptr<const LevelOfDetail>& lod,
+                const Vector& full_pose, const Eigen::Ref<const Vector>& shape,
+                const Eigen::Ref<const Vector3f>& trans,
+                const Points* template_offsets, bool enable_pose_blendshapes,
+                BodyOutputs& out) {
+    const LevelOfDetail& data = *lod;
+    const auto& kernels = cpu_kernels();
+    const size_t n_verts = data.n_verts(), n_rows = 3 * n_verts,
+                 n_shape = model.n_shape_blends();
+    out.lod = level;
+    out.lod_data = lod;
+    out.verts_shaped.resize(n_verts, 3);
+    out.verts.resize(n_verts, 3);
+    out.vert_transforms.resize(n_verts, 12);
+    out.joint_transforms.resize(model.n_joints(), 12);
+
+    Vector blendshape_params(model.n_blend_shapes());
+    blendshape_params.head(n_shape) = shape;
+    kernels.rodrigues(full_pose.data(), out.joint_transforms.data(),
+                      model.n_joints());
+    for (size_t i = 1; i < model.n_joints(); ++i) {
+        RotationMap mp(blendshape_params.data() + 9 * i + (n_shape - 9));
+        mp.noalias() = TransformMap(out.joint_transforms.row(i).data())
+                           .template leftCols<3>();
+        mp.diagonal().array() -= 1.f;
+    }
+
+    // Joints from the full mesh through the joint shape blend shapes, since
+    // the LOD lacks most of the regressed vertices
+    out.joints_shaped = data.joints;
+    if (template_offsets) {
+        out.joints_shaped.noalias() += model.joint_reg * *template_offsets;
+    }
+    Eigen::Map<Vector>(out.joints_shaped.data(), 3 * model.n_joints())
+        .noalias() += model.joint_shape_blends * shape;
+
+    out.verts_shaped.noalias() = data.verts;
+    if (template_offsets) {
+        for (size_t i = 0; i < n_verts; ++i) {
+            out.verts_shaped.row(i).noalias() +=
+                template_offsets->row(data.vert_ids[i]);
+        }
+    }
+    kernels.gemv(data.blend_shapes.data(), n_rows, blendshape_params.data(),
+                 out.verts_shaped.data(),
+                 enable_pose_blendshapes ? model.n_blend_shapes() : n_shape, 0,
+                 n_rows);
+
+    local_to_global<ModelConfig>(trans, out);
+    kernels.lbs(data.weights.outerIndexPtr(), data.weights.innerIndexPtr(),
+                data.weights.valuePtr(), out.joint_transforms.data(),
+                out.verts_shaped.data(), out.verts.data(),
+                out.vert_transforms.data(), 0, n_verts);
+}
+
+template <class ModelConfig>
+void update_pose_cached(const Model<ModelConfig>& model, PoseCache& cache,
+                        bool parallel, const Vector& full_pose,
+                        const Eigen::Ref<const Vector>& shape,
+                        const Eigen::Ref<const Vector3f>& trans,
+                        const Points* template_offsets, BodyOutputs& out) {
+    const auto& kernels = cpu_kernels();
+    const size_t n_rows = 3 * model.n_verts(), n_shape = model.n_shape_blends();
+    out.lod = 0;
+    out.lod_data.reset();
+    out.verts_shaped.resize(model.n_verts(), 3);
+    out.verts.resize(model.n_verts(), 3);
+    out.vert_transforms.resize(model.n_verts(), 12);
+    out.joint_transforms.resize(model.n_joints(), 12);
+    kernels.rodrigues(full_pose.data(), out.joint_transforms.data(),
+                      model.n_joints());
+    auto blend = [&](const Scalar* a, const Scalar* x, Scalar* y,
+                     size_t n_cols) {
+        run_range(parallel, n_rows, [&](size_t begin, size_t end) {
+            kernels.gemv(a, n_rows, x, y, n_cols, begin, end);
+        });
+    };
+
+    const Vector shape_params = shape;
+    out.verts_shaped.noalias() = model.verts;
+    if (template_offsets) out.verts_shaped.noalias() += *template_offsets;
+    blend(model.blend_shapes.data(), shape_params.data(),
+          out.verts_shaped.data(), n_shape);
+    out.joints_shaped = model.joint_reg * out.verts_shaped;
+
+    PoseCache::Offsets offsets =
+        cache.find(&model, model.generation(), full_pose);
+    if (!offsets) {
+        Vector pose_params(model.n_pose_blends());
+        for (size_t i = 1; i < model.n_joints(); ++i) {
+            RotationMap mp(pose_params.data() + 9 * (i - 1));
+            mp.noalias() = TransformMap(out.joint_transforms.row(i).data())
+                               .template leftCols<3>();
+            mp.diagonal().array() -= 1.f;
+        }
+        auto computed = std::make_shared<Vector>(Vector::Zero(n_rows));
+        blend(model.blend_shapes.data() + n_shape * n_rows, pose_params.data(),
+              computed->data(), model.n_pose_blends());
+        offsets = computed;
+        cache.insert(&model, model.generation(), full_pose, offsets);
+    }
+    Eigen::Map<Vector>(out.verts_shaped.data(), n_rows).noalias() += *offsets;
+
+    local_to_global<ModelConfig>(trans, out);
+    run_range(parallel, model.n_verts(), [&](size_t begin, size_t end) {
+        kernels.lbs(model.weights.outerIndexPtr(),
+                    model.weights.innerIndexPtr(), model.weights.valuePtr(),
+                    out.joint_transforms.data(), out.verts_shaped.data(),
+                    out.verts.data(), out.vert_transforms.data(), begin, end);
+    });
+}
+
+template <class ModelConfig>
+void local_to_global(const Eigen::Ref<const Vector3f>& trans,
+                     BodyOutputs& out) {
+    out.joints.resize(ModelConfig::n_joints(), 3);
+    // Handle root joint transforms
+    TransformTransposedMap root_transform_tr(
+        out.joint_transforms.topRows<1>().data());
+    root_transform_tr.bottomRows<1>().noalias() =
+        out.joints_shaped.topRows<1>() + trans.transpose();
+    out.joints.topRows<1>().noalias() = root_transform_tr.bottomRows<1>();
+
+    // Complete the affine transforms for all other joint by adding translation
+    // components and composing with parent
+    for (int i = 1; i < ModelConfig::n_joints(); ++i) {
+        TransformMap transform(out.joint_transforms.row(i).data());
+        const auto p = ModelConfig::parent[i];
+        // Set relative translation
+        transform.rightCols<1>().noalias() =
+            (out.joints_shaped.row(i) - out.joints_shaped.row(p)).transpose();
+        // Compose rotation with parent
+        util::mul_affine<float, Eigen::RowMajor>(
+            TransformMap(out.joint_transforms.row(p).data()), transform);
+        // Grab the joint position in case the user wants it
+        out.joints.row(i).noalias() = transform.rightCols<1>().transpose();
+    }
+
+    for (int i = 0; i < ModelConfig::n_joints(); ++i) {
+        TransformTransposedMap transform_tr(
+            out.joint_transforms.row(i).data());
+        // Translate to center at global origin
+        transform_tr.bottomRows<1>().noalias() -=
+            out.joints_shaped.row(i) * transform_tr.topRows<3>();
+    }
+}
+
+// Instantiations
+#define _SMPLX_INSTANTIATE_BACKEND(config)                                  \
+    template std::unique_ptr<ModelBackend<model_config::config>>            \
+    create_model_backend<model_config::config>(                             \
+        const Model<model_config::config>&, Backend);                       \
+    template void update_lod<model_config::config>(                         \
+        const Model<model_config::config>&, size_t,                         \
+        const std::shared_ptr<const LevelOfDetail>&, const Vector&,         \
+        const Eigen::Ref<const Vector>&, const Eigen::Ref<const Vector3f>&, \
+        const Points*, bool, BodyOutputs&);                                 \
+    template void update_pose_cached<model_config::config>(                 \
+        const Model<model_config::config>&, PoseCache&, bool, const Vector&, \
+        const Eigen::Ref<const Vector>&, const Eigen::Ref<const Vector3f>&, \
+        const Points*, BodyOutputs&);                                       \
+    template void local_to_global<model_config::config>(                    \
+        const Eigen::Ref<const Vector3f>&, BodyOutputs&)
+_SMPLX_INSTANTIATE_BACKEND(SMPL);
+_SMPLX_INSTANTIATE_BACKEND(SMPL_v1);
+_SMPLX_INSTANTIATE_BACKEND(SMPLH);
+_SMPLX_INSTANTIATE_BACKEND(SMPLX);
+_SMPLX_INSTANTIATE_BACKEND(SMPLXpca);
+_SMPLX_INSTANTIATE_BACKEND(SMPLX_v1);
+_SMPLX_INSTANTIATE_BACKEND(SMPLXpca_v1);
+#undef _SMPLX_INSTANTIATE_BACKEND
+
+}  // namespace internal
+}  // namespace smplx
@@ -1,96 +1,921 @@
+#include <algorithm>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <stdexcept>
 
+#include "smplx/internal/cpu_kernels.hpp"
 #include "smplx/smplx.hpp"
+#include "smplx/thread_pool.hpp"
 #include "smplx/util.hpp"
 
 namespace smplx {
 
 template <class ModelConfig>
 Body<ModelConfig>::Body(const Model<ModelConfig>& model, bool set_zero)
-    : model(model), params(model.n_params()) {
+    : model(model),
+      params(model.n_params()),
+      _out(std::make_shared<Buffer>()) {
     if (set_zero) this->set_zero();
-    // Point cloud after applying shape keys but before lbs (num points, 3)
-    _verts_shaped.resize(model.n_verts(), 3);
-
-    // Joints after applying shape keys but before lbs (num joints, 3)
-    _joints_shaped.resize(model.n_joints(), 3);
+}
 
-    // Final deformed point cloud
-    _verts.resize(model.n_verts(), 3);
+template <class ModelConfig>
+Body<ModelConfig>::Body(const Body& other)
+    : model(other.model),
+      params(other.params),
+      _backend(other._backend),
+      _lod(other._lod),
+      _lod_data(other._lod_data),
+      _pose_cache(other._pose_cache),
+      _template_offsets(other._template_offsets),
+      _disp_ids(other._disp_ids),
+      _disp_offsets(other._disp_offsets),
+      _disp_space(other._disp_space) {
+    other.wait();
+    // Bring lazy outputs up to date before copying
+    other.vert_transforms();
+    other.verts_shaped();
+    std::lock_guard<std::recursive_mutex> lock(other._cache_mtx);
+    _out = std::make_shared<Buffer>(*other._front());
+    _double_buffered = other._double_buffered;
+    _n_updates = other._n_updates;
+}
 
-    // Affine joint transformation, as 3x4 matrices stacked horizontally (bottom
-    // row omitted) NOTE: col major
-    _joint_transforms.resize(model.n_joints(), 12);
-#ifdef SMPLX_CUDA_ENABLED
-    _cuda_load();
-#endif
+template <class ModelConfig>
+typename Body<ModelConfig>::Buffer& Body<ModelConfig>::Buffer::operator=(
+    const Buffer& other) {
+    Snapshot::operator=(other);
+    face_normals = other.face_normals;
+    normals_computed = other.normals_computed.load();
+    normals_face_stale = other.normals_face_stale;
+    verts_uvn_computed = other.verts_uvn_computed.load();
+    update_id = other.update_id;
+    return *this;
 }
 
 template <class ModelConfig>
 Body<ModelConfig>::~Body() {
-#ifdef SMPLX_CUDA_ENABLED
-    _cuda_free();
-#endif
+    // The pending task refers to this body
+    wait();
+}
+
+template <class ModelConfig>
+void Body<ModelConfig>::set_backend(Backend backend) {
+    if (!util::backend_available(backend)) {
+        throw std::invalid_argument(std::string("Backend ") +
+                                    util::backend_to_str(backend) +
+                                    " is not available in this build");
+    }
+    _backend = backend;
+}
+
+template <class ModelConfig>
+void Body<ModelConfig>::set_lod(size_t level) {
+    if (level >= model.n_lods()) {
+        throw std::invalid_argument("Level of detail " +
+                                    std::to_string(level) +
+                                    " does not exist in the model");
+    }
+    _lod = level;
+    _lod_data = level ? model.lod_ptr(level) : nullptr;
+}
+
+template <class ModelConfig>
+void Body<ModelConfig>::set_template_offsets(
+    std::shared_ptr<const Points> offsets) {
+    if (offsets && (size_t)offsets->rows() != model.n_verts()) {
+        throw std::invalid_argument(
+            "Template offsets have " + std::to_string(offsets->rows()) +
+            " rows, expected " + std::to_string(model.n_verts()));
+    }
+    wait();
+    _template_offsets = std::move(offsets);
+    _face_cache_valid = false;
+}
+
+template <class ModelConfig>
+void Body<ModelConfig>::set_template_offsets(
+    const Eigen::Ref<const Points>& offsets) {
+    set_template_offsets(std::make_shared<const Points>(offsets));
+}
+
+template <class ModelConfig>
+void Body<ModelConfig>::set_displacements(
+    const std::vector<Index>& vert_ids,
+    const Eigen::Ref<const Points>& offsets, DisplacementSpace space) {
+    if ((size_t)offsets.rows() != vert_ids.size()) {
+        throw std::invalid_argument(
+            "Displacements have " + std::to_string(offsets.rows()) +
+            " offsets for " + std::to_string(vert_ids.size()) + " vertices");
+    }
+    for (Index v : vert_ids) {
+        if (v >= model.n_verts()) {
+            throw std::invalid_argument("Displaced vertex " +
+                                        std::to_string(v) +
+                                        " is not in the model");
+        }
+    }
+    wait();
+    _disp_ids = vert_ids;
+    _disp_offsets = offsets;
+    _disp_space = space;
+    _disp_changed = true;
+}
+
+template <class ModelConfig>
+void Body<ModelConfig>::clear_displacements() {
+    wait();
+    _disp_ids.clear();
+    _disp_offsets.resize(0, 3);
+    _disp_changed = true;
+}
+
+template <class ModelConfig>
+Eigen::Map<const Triangles> Body<ModelConfig>::faces() const {
+    _wait_outputs();
+    return _faces(*_front());
+}
+
+template <class ModelConfig>
+Eigen::Map<const Triangles> Body<ModelConfig>::_faces(
+    const Outputs& out) const {
+    if (!out.lod_data) return model.faces;
+    const Triangles& faces = out.lod_data->faces;
+    return Eigen::Map<const Triangles>(faces.data(), faces.rows(), 3);
+}
+
+template <class ModelConfig>
+Eigen::Map<const SparseMatrix> Body<ModelConfig>::_vert_faces(
+    const Outputs& out) const {
+    if (!out.lod_data) return model.vert_faces;
+    const SparseMatrix& vert_faces = out.lod_data->vert_faces;
+    return Eigen::Map<const SparseMatrix>(
+        vert_faces.rows(), vert_faces.cols(), vert_faces.nonZeros(),
+        vert_faces.outerIndexPtr(), vert_faces.innerIndexPtr(),
+        vert_faces.valuePtr());
+}
+
+template <class ModelConfig>
+void Body<ModelConfig>::set_double_buffered(bool enable) {
+    wait();
+    if (_double_buffered && !enable) {
+        // Readers may still hold the front buffer; stop writing to it
+        std::lock_guard<std::recursive_mutex> lock(_cache_mtx);
+        std::atomic_store(&_out, std::make_shared<Buffer>(*_front()));
+    } else if (enable) {
+        // Published outputs are complete
+        vert_transforms();
+        _sync_host();
+    }
+    _double_buffered = enable;
+    _spare.reset();
+}
+
+template <class ModelConfig>
+std::shared_ptr<typename Body<ModelConfig>::Buffer>
+Body<ModelConfig>::_back_buffer() {
+    std::shared_ptr<Buffer> out = _front();
+    if (_double_buffered) {
+        // Reuse the previous front buffer unless a reader still holds it
+        out = std::move(_spare);
+        if (!out || out.use_count() > 1) {
+            out = std::make_shared<Buffer>();
+        } else {
+            // use_count() is a relaxed load: order our writes after the
+            // reads of the reader which released the buffer last
+            std::atomic_thread_fence(std::memory_order_acquire);
+        }
+    }
+    return out;
+}
+
+template <class ModelConfig>
+std::shared_ptr<const typename Body<ModelConfig>::Snapshot>
+Body<ModelConfig>::snapshot(bool with_normals) const {
+    if (_double_buffered) {
+        const std::shared_ptr<Buffer> front = _front();
+        // Cached with the buffer, which readers then only read
+        if (with_normals) _verts_uvn(*front);
+        return front;
+    }
+    vert_transforms();
+    _sync_host();
+    const std::shared_ptr<Buffer> front = _front();
+    if (with_normals) _verts_uvn(*front);
+    auto snap = std::make_shared<Snapshot>();
+    static_cast<Outputs&>(*snap) = *front;
+    if (with_normals) {
+        snap->normals = front->normals;
+        snap->verts_uvn = front->verts_uvn;
+    }
+    return snap;
+}
+
+template <class ModelConfig>
+void Body<ModelConfig>::_sync_host() const {
+    _wait_outputs();
+    _compute_once(_host_synced, [this]() {
+        if (!_backend_state) return;
+        const std::shared_ptr<Buffer> out = _front();
+        _backend_state->retrieve_verts(*out);
+        _backend_state->retrieve_verts_shaped(*out);
+    });
 }
 
 template <class ModelConfig>
 const Points& Body<ModelConfig>::verts() const {
-#ifdef SMPLX_CUDA_ENABLED
-    if (_last_update_used_gpu) _cuda_maybe_retrieve_verts();
-#endif
-    return _verts;
+    _sync_host();
+    return _front()->verts;
 }
 
 template <class ModelConfig>
 const Points& Body<ModelConfig>::verts_shaped() const {
-#ifdef SMPLX_CUDA_ENABLED
-    if (_last_update_used_gpu) _cuda_maybe_retrieve_verts_shaped();
-#endif
-    return _verts_shaped;
+    _sync_host();
+    return _front()->verts_shaped;
 }
 
 template <class ModelConfig>
 const Points& Body<ModelConfig>::joints() const {
-    return _joints;
+    _wait_outputs();
+    return _front()->joints;
 }
 
 template <class ModelConfig>
 const Eigen::Matrix<Scalar, Eigen::Dynamic, 12, Eigen::RowMajor>&
 Body<ModelConfig>::joint_transforms() const {
-    return _joint_transforms;
+    _wait_outputs();
+    return _front()->joint_transforms;
 }
 
 template <class ModelConfig>
 const Eigen::Matrix<Scalar, Eigen::Dynamic, 12, Eigen::RowMajor>&
 Body<ModelConfig>::vert_transforms() const {
-    if (_vert_transforms.rows() == 0) {
-        _vert_transforms.noalias() = model.weights * _joint_transforms;
+    _wait_outputs();
+    const std::shared_ptr<Buffer> out = _front();
+    _compute_once(_vert_transforms_ready, [&]() {
+        out->vert_transforms.noalias() =
+            model.weights * out->joint_transforms;
+    });
+    return out->vert_transforms;
+}
+
+template <class ModelConfig>
+const Points& Body<ModelConfig>::normals() const {
+    _sync_host();
+    return _normals(*_front());
+}
+
+template <class ModelConfig>
+const Points& Body<ModelConfig>::_normals(Buffer& out) const {
+    _compute_once(out.normals_computed, [&]() {
+        if (out.normals_face_stale) {
+            _compute_normals_local(out, model.face_verts);
+        } else {
+            _compute_normals(out, 1);
+        }
+        out.normals_face_stale = false;
+    });
+    return out.normals;
+}
+
+template <class ModelConfig>
+void Body<ModelConfig>::update_normals(size_t n_threads) {
+    _sync_host();
+    const std::shared_ptr<Buffer> out = _front();
+    std::lock_guard<std::recursive_mutex> lock(_cache_mtx);
+    // Snapshots may be reading them
+    if (out->normals_computed) return;
+    if (out->normals_face_stale) {
+        _compute_normals_local(*out, model.face_verts);
+    } else {
+        _compute_normals(*out, n_threads);
     }
-    return _vert_transforms;
+    out->normals_face_stale = false;
+    out->normals_computed = true;
+}
+
+template <class ModelConfig>
+const PointsUVN& Body<ModelConfig>::verts_uvn() const {
+    _sync_host();
+    return _verts_uvn(*_front());
+}
+
+template <class ModelConfig>
+const PointsUVN& Body<ModelConfig>::_verts_uvn(Buffer& out) const {
+    _compute_once(out.verts_uvn_computed, [&]() {
+        const Points& cur_verts = out.verts;
+        const Points& cur_normals = _normals(out);
+        PointsUVN& verts_uvn = out.verts_uvn;
+        if (model.has_uv_map() && out.lod == 0) {
+            model.require(ModelComponent::uv_map);
+            // Expand to UV vertices, duplicating along seams
+            verts_uvn.resize(model.n_uv_verts(), 8);
+            for (size_t i = 0; i < model.n_uv_verts(); ++i) {
+                const Index v = model.uv_to_vert[i];
+                verts_uvn.row(i).template head<3>().noalias() =
+                    cur_verts.row(v);
+                verts_uvn.row(i).template segment<2>(3).noalias() =
+                    model.uv.row(i);
+                verts_uvn.row(i).template tail<3>().noalias() =
+                    cur_normals.row(v);
+            }
+        } else {
+            verts_uvn.resize(cur_verts.rows(), 8);
+            verts_uvn.template leftCols<3>().noalias() = cur_verts;
+            verts_uvn.template middleCols<2>(3).setZero();
+            verts_uvn.template rightCols<3>().noalias() = cur_normals;
+        }
+    });
+    return out.verts_uvn;
+}
+
+// The posed vertex is v = sum_k w_k A_k [v_shaped; 1], with A_k the joint
+// transforms. Rotating joint j by d(aa) moves every transform in its subtree
+// by the same rigid motion about the posed joint c_j, with angular velocity
+// U_j d(aa), U_j = R_parent(j) * rodrigues_jacobian(aa_j). Hence
+// dv/d(aa_j) = -skew(q_j - s_j c_j) U_j, where s_j and q_j are the sums of
+// w_k and w_k A_k [v_shaped; 1] over skinning joints k in the subtree of j.
+// Shape moves v_shaped directly and all A_k through the joints.
+template <class ModelConfig>
+SparseMatrix Body<ModelConfig>::jacobian(const std::vector<Index>& vert_ids,
+                                         const std::vector<Index>& joint_ids,
+                                         bool pose_blendshapes) const {
+    using Matrix3 = Eigen::Matrix<Scalar, 3, 3>;
+    using TransformConstMap =
+        Eigen::Map<const Eigen::Matrix<Scalar, 3, 4, Eigen::RowMajor>>;
+    const size_t n_joints = model.n_joints(),
+                 n_explicit = model.n_explicit_joints(),
+                 n_hand_joints = model.n_hand_pca_joints(),
+                 n_pca = model.n_hand_pca(), n_shape = model.n_shape_blends();
+    // Column offsets of each part of params
+    const size_t pose_col = 3, pca_col = 3 + 3 * n_explicit,
+                 shape_col = pca_col + 2 * n_pca;
+    model.require(ModelComponent::shape_blends);
+    if (pose_blendshapes) model.require(ModelComponent::pose_blends);
+
+    const Points& cur_verts_shaped = verts_shaped();
+    const auto& cur_joint_transforms = joint_transforms();
+    const auto& cur_vert_transforms = vert_transforms();
+    const Points& cur_joints = joints();
+    const Vector full_pose = this->full_pose();
+
+    // Per joint: U_j, and derivatives of the local rotation in the layout of
+    // the pose blend shape params (9, 3)
+    std::vector<Matrix3> axis_jac(n_joints);
+    std::vector<Eigen::Matrix<Scalar, 9, 3>> rot_jac(n_joints);
+    for (size_t j = 0; j < n_joints; ++j) {
+        const Vector3f aa = full_pose.template segment<3>(3 * j);
+        const Matrix3 jac = util::rodrigues_jacobian<float>(aa);
+        axis_jac[j].noalias() =
+            j ? TransformConstMap(
+                    cur_joint_transforms.row(ModelConfig::parent[j]).data())
+                        .template leftCols<3>() *
+                    jac
+              : jac;
+        if (!pose_blendshapes || j == 0) continue;
+        const Matrix3 rot = util::rodrigues<float>(aa);
+        for (size_t c = 0; c < 3; ++c) {
+            const Vector3f col = jac.col(c);
+            const Matrix3 drot = util::skew<float>(col) * rot;
+            for (size_t r = 0; r < 3; ++r) {
+                rot_jac[j].template block<3, 1>(3 * r, c) =
+                    drot.row(r).transpose();
+            }
+        }
+    }
+
+    // Shape derivatives of the posed joints (dg) and of the translation part
+    // of the joint transforms (dt), (3*#joints, #shape blends)
+    const auto& jsb = model.joint_shape_blends;
+    MatrixColMajor dg(3 * n_joints, n_shape), dt(3 * n_joints, n_shape);
+    for (size_t k = 0; k < n_joints; ++k) {
+        const auto rot_k =
+            TransformConstMap(cur_joint_transforms.row(k).data())
+                .template leftCols<3>();
+        if (k == 0) {
+            dg.topRows<3>().noalias() = jsb.template topRows<3>();
+        } else {
+            const size_t p = ModelConfig::parent[k];
+            dg.middleRows<3>(3 * k).noalias() =
+                dg.middleRows<3>(3 * p) +
+                TransformConstMap(cur_joint_transforms.row(p).data())
+                        .template leftCols<3>() *
+                    (jsb.template middleRows<3>(3 * k) -
+                     jsb.template middleRows<3>(3 * p));
+        }
+        dt.middleRows<3>(3 * k).noalias() =
+            dg.middleRows<3>(3 * k) -
+            rot_k * jsb.template middleRows<3>(3 * k);
+    }
+
+    // Output CSR, filled row by row with ascending columns
+    const size_t n_rows = 3 * (vert_ids.size() + joint_ids.size());
+    std::vector<int> outer(1, 0), inner;
+    std::vector<Scalar> values;
+    outer.reserve(n_rows + 1);
+    // Each row has at least the translation and shape columns
+    inner.reserve(n_rows * (3 + n_shape + 2 * n_pca));
+    values.reserve(inner.capacity());
+    // Current 3 rows, valid at the columns listed in cols
+    Eigen::Matrix<Scalar, 3, Eigen::Dynamic> block(3, model.n_params());
+    std::vector<int> cols;
+    auto emit = [&]() {
+        for (int r = 0; r < 3; ++r) {
+            const size_t start = inner.size();
+            inner.insert(inner.end(), cols.begin(), cols.end());
+            values.resize(inner.size());
+            Scalar* out = values.data() + start;
+            for (size_t c = 0; c < cols.size(); ++c) {
+                out[c] = block(r, cols[c]);
+            }
+            outer.push_back((int)inner.size());
+        }
+    };
+    auto push_cols = [&](size_t begin, size_t count) {
+        for (size_t c = begin; c < begin + count; ++c) cols.push_back(c);
+    };
+    // Place derivative d w.r.t. joint j's angle-axis at its params columns;
+    // hand joints driven by PCA go through the PCA components
+    bool hand_used;
+    auto put_joint = [&](size_t j, const Matrix3& d) {
+        if (j < n_explicit) {
+            block.template middleCols<3>(pose_col + 3 * j) = d;
+            push_cols(pose_col + 3 * j, 3);
+            return;
+        }
+        const bool left = j < n_explicit + n_hand_joints;
+        const size_t hand_j = j - n_explicit - (left ? 0 : n_hand_joints);
+        const Matrix& comps = left ? model.hand_comps_l : model.hand_comps_r;
+        block.middleCols(pca_col + (left ? 0 : n_pca), n_pca).noalias() +=
+            d * comps.middleRows(3 * hand_j, 3);
+        hand_used = true;
+    };
+    auto begin_row = [&]() {
+        cols.clear();
+        hand_used = false;
+        block.template leftCols<3>().setIdentity();
+        push_cols(0, 3);
+        if (n_pca) block.middleCols(pca_col, 2 * n_pca).setZero();
+    };
+    auto end_row = [&]() {
+        if (hand_used) push_cols(pca_col, 2 * n_pca);
+        push_cols(shape_col, n_shape);
+        emit();
+    };
+
+    // Rows of model data at the vertices of the outputs' level of detail
+    const std::shared_ptr<const LevelOfDetail> lod = _front()->lod_data;
+    const std::vector<Index>* lod_verts = lod ? &lod->vert_ids : nullptr;
+    std::vector<Scalar> weight_sum(n_joints);
+    std::vector<Vector3f> weighted_pos(n_joints);
+    for (Index i : vert_ids) {
+        _SMPLX_ASSERT_LT(i, cur_verts_shaped.rows());
+        const Index mi = lod_verts ? (*lod_verts)[i] : i;
+        begin_row();
+        const Matrix3 vert_rot =
+            TransformConstMap(cur_vert_transforms.row(i).data())
+                .template leftCols<3>();
+        const Vector3f vs = cur_verts_shaped.row(i).transpose();
+        std::fill(weight_sum.begin(), weight_sum.end(), 0.f);
+        std::fill(weighted_pos.begin(), weighted_pos.end(),
+                  Vector3f::Zero());
+        block.middleCols(shape_col, n_shape).noalias() =
+            vert_rot * model.blend_shapes.block(3 * mi, 0, 3, n_shape);
+        for (SparseMatrix::InnerIterator it(model.weights, mi); it; ++it) {
+            const size_t k = it.col();
+            const Scalar w = it.value();
+            const TransformConstMap transform(
+                cur_joint_transforms.row(k).data());
+            const Vector3f pos = transform.template leftCols<3>() * vs +
+                                 transform.template rightCols<1>();
+            for (size_t j = k;; j = ModelConfig::parent[j]) {
+                weight_sum[j] += w;
+                weighted_pos[j] += w * pos;
+                if (j == 0) break;
+            }
+            block.middleCols(shape_col, n_shape).noalias() +=
+                w * dt.middleRows<3>(3 * k);
+        }
+        block.template leftCols<3>() *= weight_sum[0];
+
+        for (size_t j = 0; j < n_joints; ++j) {
+            const bool skinned = weight_sum[j] != 0.f;
+            const bool blended = pose_blendshapes && j > 0;
+            if (!skinned && !blended) continue;
+            Matrix3 d = Matrix3::Zero();
+            if (skinned) {
+                const Vector3f arm = weighted_pos[j] -
+                                     weight_sum[j] *
+                                         cur_joints.row(j).transpose();
+                d.noalias() = -util::skew<float>(arm) * axis_jac[j];
+            }
+            if (blended) {
+                d.noalias() +=
+                    vert_rot *
+                    (model.blend_shapes.template block<3, 9>(
+                         3 * mi, n_shape + 9 * (j - 1)) *
+                     rot_jac[j]);
+            }
+            put_joint(j, d);
+        }
+        end_row();
+    }
+
+    std::vector<size_t> chain;
+    for (Index i : joint_ids) {
+        _SMPLX_ASSERT_LT(i, n_joints);
+        begin_row();
+        // Ancestors of joint i, root first; joint i's own rotation
+        // does not move it
+        chain.clear();
+        for (size_t j = i; j != 0;) {
+            j = ModelConfig::parent[j];
+            chain.push_back(j);
+        }
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+            const Vector3f arm =
+                (cur_joints.row(i) - cur_joints.row(*it)).transpose();
+            put_joint(*it, -util::skew<float>(arm) * axis_jac[*it]);
+        }
+        block.middleCols(shape_col, n_shape) = dg.middleRows<3>(3 * i);
+        end_row();
+    }
+
+    SparseMatrix result(n_rows, model.n_params());
+    result.resizeNonZeros(values.size());
+    std::copy(outer.begin(), outer.end(), result.outerIndexPtr());
+    std::copy(inner.begin(), inner.end(), result.innerIndexPtr());
+    std::copy(values.begin(), values.end(), result.valuePtr());
+    return result;
 }
 
-// Main LBS routine
 template <class ModelConfig>
 void Body<ModelConfig>::update(bool force_cpu, bool enable_pose_blendshapes) {
-    // _SMPLX_BEGIN_PROFILE;
-    // Will store full pose params (angle-axis), including hand
-    Vector full_pose(3 * model.n_joints());
+    wait();
+    _update(force_cpu, enable_pose_blendshapes);
+}
 
-    // Shape params +/ linear joint transformations as flattened 3x3 rotation
-    // matrices rowmajor, only for blend shapes
-    Vector blendshape_params(model.n_blend_shapes());
+template <class ModelConfig>
+std::shared_future<void> Body<ModelConfig>::update_async(
+    bool force_cpu, bool enable_pose_blendshapes,
+    std::function<void(const Body&)> then) {
+    wait();
+    // Promises are move-only; the pool takes copyable tasks
+    auto outputs_done = std::make_shared<std::promise<void>>();
+    auto done = std::make_shared<std::promise<void>>();
+    {
+        std::lock_guard<std::mutex> lock(_pending_mtx);
+        _pending_outputs = outputs_done->get_future().share();
+        _pending = done->get_future().share();
+    }
+    ThreadPool::global().push([this, force_cpu, enable_pose_blendshapes,
+                               then, outputs_done, done]() {
+        try {
+            _update(force_cpu, enable_pose_blendshapes);
+        } catch (...) {
+            outputs_done->set_value();
+            done->set_exception(std::current_exception());
+            return;
+        }
+        outputs_done->set_value();
+        if (then) {
+            // So that wait() from the continuation does not wait for itself
+            _continuation_thread = std::this_thread::get_id();
+            try {
+                then(*this);
+            } catch (...) {
+                _continuation_thread = std::thread::id();
+                done->set_exception(std::current_exception());
+                return;
+            }
+            _continuation_thread = std::thread::id();
+        }
+        done->set_value();
+    });
+    return _pending;
+}
 
-    using TransformMap =
-        Eigen::Map<Eigen::Matrix<Scalar, 3, 4, Eigen::RowMajor>>;
-    using TransformTransposedMap = Eigen::Map<Eigen::Matrix<Scalar, 4, 3>>;
+template <class ModelConfig>
+bool Body<ModelConfig>::_can_update_face(bool enable_pose_blendshapes) const {
+    static_assert(ModelConfig::face_joint_begin() +
+                          ModelConfig::n_face_joints() <=
+                      ModelConfig::n_explicit_joints(),
+                  "Face joints must be explicit joints");
+    model.require(ModelComponent::face_region);
+    if (model.face_verts.empty() || _lod != 0 || _front()->lod != 0 ||
+        _disp_changed ||
+        _base_params.size() != params.size() ||
+        enable_pose_blendshapes != _base_pose_blendshapes) {
+        return false;
+    }
+    // All params but the face pose and expression must match the base
+    const size_t face_pose = 3 + 3 * ModelConfig::face_joint_begin(),
+                 face_pose_end = face_pose + 3 * ModelConfig::n_face_joints(),
+                 expr = model.n_params() - model.n_expression_blends();
+    return params.head(face_pose) == _base_params.head(face_pose) &&
+           params.segment(face_pose_end, expr - face_pose_end) ==
+               _base_params.segment(face_pose_end, expr - face_pose_end);
+}
+
+// Only the face region moves: its verts_shaped is a constant rest plus the
+// expression and face pose blend shapes, and since the joints are cheap, all
+// joint transforms are recomputed. LBS is then redone for the face region.
+template <class ModelConfig>
+bool Body<ModelConfig>::update_face(bool enable_pose_blendshapes) {
     using RotationMap =
         Eigen::Map<Eigen::Matrix<Scalar, 3, 3, Eigen::RowMajor>>;
+    wait();
+    if (!_can_update_face(enable_pose_blendshapes)) {
+        _update(false, enable_pose_blendshapes);
+        return false;
+    }
+    const auto& face_verts = model.face_verts;
+    const size_t n_face = face_verts.size(), n_joints = model.n_joints(),
+                 n_shape = model.n_shape_blends(),
+                 n_expr = model.n_expression_blends(),
+                 n_body_shape = n_shape - n_expr,
+                 face_joint = ModelConfig::face_joint_begin(),
+                 n_face_joints = ModelConfig::n_face_joints();
+    const Vector full_pose = this->full_pose();
+
+    if (!_face_cache_valid) {
+        // Pose blend shape params of all but the face joints
+        Vector pose_params = Vector::Zero(model.n_pose_blends());
+        if (enable_pose_blendshapes) {
+            for (size_t j = 1; j < n_joints; ++j) {
+                if (j >= face_joint && j < face_joint + n_face_joints) continue;
+                RotationMap mp(pose_params.data() + 9 * (j - 1));
+                mp.noalias() = util::rodrigues<float, Eigen::RowMajor>(
+                    full_pose.template segment<3>(3 * j));
+                mp.diagonal().array() -= 1.f;
+            }
+        }
+        _face_rest.resize(3 * n_face);
+        for (size_t i = 0; i < n_face; ++i) {
+            const size_t row = 3 * face_verts[i];
+            _face_rest.template segment<3>(3 * i).noalias() =
+                model.verts.row(face_verts[i]).transpose() +
+                model.blend_shapes.block(row, 0, 3, n_body_shape) *
+                    shape().head(n_body_shape);
+            if (_template_offsets) {
+                _face_rest.template segment<3>(3 * i).noalias() +=
+                    _template_offsets->row(face_verts[i]).transpose();
+            }
+            if (enable_pose_blendshapes) {
+                _face_rest.template segment<3>(3 * i).noalias() +=
+                    model.blend_shapes.block(row, n_shape, 3,
+                                             model.n_pose_blends()) *
+                    pose_params;
+            }
+        }
+        Points joints_rest = model.joint_reg * model.verts;
+        if (_template_offsets) {
+            joints_rest.noalias() += model.joint_reg * *_template_offsets;
+        }
+        _face_joints_rest =
+            Eigen::Map<const Vector>(joints_rest.data(), 3 * n_joints) +
+            model.joint_shape_blends.leftCols(n_body_shape) *
+                shape().head(n_body_shape);
+        _face_cache_valid = true;
+    }
+
+    // Start from the complete outputs of the latest update
+    _sync_host();
+    vert_transforms();
+    const std::shared_ptr<Buffer> front = _front();
+    const std::shared_ptr<Buffer> out = _back_buffer();
+    if (out->update_id != front->update_id) {
+        // Readers may be computing the caches of the front buffer
+        std::lock_guard<std::recursive_mutex> lock(_cache_mtx);
+        *out = *front;
+    }
+    // Else out is an earlier face update of the same full update: only the
+    // rows written below differ
+    out->normals_face_stale =
+        out->normals_computed || out->normals_face_stale;
+    out->normals_computed = out->verts_uvn_computed = false;
+
+    const auto& kernels = internal::cpu_kernels();
+    kernels.rodrigues(full_pose.data(), out->joint_transforms.data(),
+                      n_joints);
+    // Expression and face pose blend shape params
+    const size_t n_face_params =
+        n_expr + (enable_pose_blendshapes ? 9 * n_face_joints : 0);
+    Vector face_params(n_face_params);
+    face_params.head(n_expr) = expression();
+    if (enable_pose_blendshapes) {
+        for (size_t k = 0; k < n_face_joints; ++k) {
+            RotationMap mp(face_params.data() + n_expr + 9 * k);
+            mp.noalias() =
+                Eigen::Map<const Eigen::Matrix<Scalar, 3, 4, Eigen::RowMajor>>(
+                    out->joint_transforms.row(face_joint + k).data())
+                    .template leftCols<3>();
+            mp.diagonal().array() -= 1.f;
+        }
+    }
+
+    Eigen::Map<Vector>(out->joints_shaped.data(), 3 * n_joints).noalias() =
+        _face_joints_rest +
+        model.joint_shape_blends.rightCols(n_expr) * expression();
+    internal::local_to_global<ModelConfig>(trans(), *out);
+
+    Vector face_shaped = _face_rest;
+    kernels.gemv(model.face_blend_shapes.data(), 3 * n_face,
+                 face_params.data(), face_shaped.data(), n_face_params, 0,
+                 3 * n_face);
+    for (size_t i = 0; i < n_face; ++i) {
+        out->verts_shaped.row(face_verts[i]).noalias() =
+            face_shaped.template segment<3>(3 * i).transpose();
+    }
+    // LBS over runs of consecutive face vertices
+    for (size_t i = 0; i < n_face;) {
+        size_t end = i + 1;
+        while (end < n_face && face_verts[end] == face_verts[end - 1] + 1) {
+            ++end;
+        }
+        kernels.lbs(model.weights.outerIndexPtr(),
+                    model.weights.innerIndexPtr(), model.weights.valuePtr(),
+                    out->joint_transforms.data(), out->verts_shaped.data(),
+                    out->verts.data(), out->vert_transforms.data(),
+                    face_verts[i], face_verts[end - 1] + 1);
+        i = end;
+    }
+    if (!_disp_ids.empty()) _displace(*out, true);
+
+    if (_double_buffered) _spare = std::atomic_exchange(&_out, out);
+    return true;
+}
+
+// Main LBS routine
+template <class ModelConfig>
+void Body<ModelConfig>::_update(bool force_cpu, bool enable_pose_blendshapes) {
+    // Changed by Model::set_shape_space or loading another shape space
+    _SMPLX_ASSERT_EQ(params.size(), model.n_params());
+    if (_template_offsets) {
+        _SMPLX_ASSERT_EQ((size_t)_template_offsets->rows(), model.n_verts());
+    }
+    _base_params = params;
+    _base_pose_blendshapes = enable_pose_blendshapes;
+    _face_cache_valid = false;
+    _disp_changed = false;
+    // _SMPLX_BEGIN_PROFILE;
+    const Vector full_pose = this->full_pose();
+    if (enable_pose_blendshapes) {
+        model.require(
+            {ModelComponent::shape_blends, ModelComponent::pose_blends});
+    } else {
+        model.require(ModelComponent::shape_blends);
+    }
+
+    Backend backend = internal::resolve_backend(_backend, model.backend());
+    if (force_cpu && backend == Backend::cuda) backend = Backend::cpu_simd;
+    const bool pose_cached =
+        _pose_cache && enable_pose_blendshapes && backend != Backend::cuda;
+    const std::shared_ptr<Buffer> out = _back_buffer();
+    out->normals_computed = out->verts_uvn_computed = false;
+    out->normals_face_stale = false;
+    out->update_id = ++_n_updates;
+    if (_lod || pose_cached) {
+        // Evaluated here on the CPU, bypassing the backend
+        if (_lod) {
+            internal::update_lod(model, _lod, _lod_data, full_pose, shape(),
+                                 trans(), _template_offsets.get(),
+                                 enable_pose_blendshapes, *out);
+        } else {
+            internal::update_pose_cached(
+                model, *_pose_cache, backend == Backend::cpu_parallel,
+                full_pose, shape(), trans(), _template_offsets.get(), *out);
+        }
+        if (!_disp_ids.empty()) _displace(*out, false);
+        _host_synced = _vert_transforms_ready = true;
+        if (_double_buffered) _spare = std::atomic_exchange(&_out, out);
+        return;
+    }
+
+    if (!_backend_state || _backend_state_type != backend) {
+        // Retrieve outputs of the previous backend before dropping its state
+        if (_backend_state && !_host_synced) {
+            const std::shared_ptr<Buffer> front = _front();
+            _backend_state->retrieve_verts(*front);
+            _backend_state->retrieve_verts_shaped(*front);
+        }
+        _backend_state = model.backend_data(backend).create_body();
+        _backend_state_type = backend;
+    }
+
+    out->lod = 0;
+    out->lod_data.reset();
+    _backend_state->update(full_pose, shape(), trans(),
+                           _template_offsets.get(), enable_pose_blendshapes,
+                           *out);
+    // _SMPLX_PROFILE(update);
+
+    // Published outputs are immutable, so complete them now; displacements
+    // are added on the host
+    const bool displace = !_disp_ids.empty();
+    if (_double_buffered || displace) {
+        _backend_state->retrieve_verts(*out);
+        _backend_state->retrieve_verts_shaped(*out);
+        if (displace) _displace(*out, false);
+    }
+    if (_double_buffered) {
+        if (out->vert_transforms.rows() == 0) {
+            out->vert_transforms.noalias() =
+                model.weights * out->joint_transforms;
+        }
+        _host_synced = _vert_transforms_ready = true;
+        _spare = std::atomic_exchange(&_out, out);
+    } else {
+        _host_synced = displace;
+        _vert_transforms_ready = out->vert_transforms.rows() != 0;
+    }
+}
+
+template <class ModelConfig>
+MemoryUsage Body<ModelConfig>::memory_usage() const {
+    using util::dense_bytes;
+    _wait_outputs();
+    auto outputs_bytes = [](const Outputs& out) {
+        return dense_bytes(out.verts_shaped) + dense_bytes(out.verts) +
+               dense_bytes(out.joints_shaped) + dense_bytes(out.joints) +
+               dense_bytes(out.joint_transforms) +
+               dense_bytes(out.vert_transforms);
+    };
+    auto cache_bytes = [](const Buffer& out) {
+        return dense_bytes(out.normals) + dense_bytes(out.face_normals) +
+               dense_bytes(out.verts_uvn);
+    };
+    const std::shared_ptr<Buffer> front = _front();
+    MemoryUsage usage;
+    auto& parts = usage.parts;
+    parts["params"] = dense_bytes(params);
+    parts["outputs"] = outputs_bytes(*front);
+    std::lock_guard<std::recursive_mutex> lock(_cache_mtx);
+    // Back buffer of double buffering, with its caches
+    parts["spare_outputs"] = _spare && _spare != front
+                                 ? outputs_bytes(*_spare) + cache_bytes(*_spare)
+                                 : 0;
+    parts["face_cache"] = dense_bytes(_base_params) +
+                          dense_bytes(_face_rest) +
+                          dense_bytes(_face_joints_rest);
+    // Shared by the bodies given the same offsets, counted in full
+    parts["template_offsets"] =
+        _template_offsets ? dense_bytes(*_template_offsets) : 0;
+    parts["displacements"] =
+        _disp_ids.size() * sizeof(Index) + dense_bytes(_disp_offsets);
+    parts["normals"] =
+        dense_bytes(front->normals) + dense_bytes(front->face_normals);
+    parts["verts_uvn"] = dense_bytes(front->verts_uvn);
+    return usage;
+}
+
+template <class ModelConfig>
+void Body<ModelConfig>::_displace(Outputs& out, bool face_only) const {
+    using TransformMap =
+        Eigen::Map<const Eigen::Matrix<Scalar, 3, 4, Eigen::RowMajor>>;
+    // Vertex ids are those of the full mesh
+    if (out.lod) return;
+    const auto& face_verts = model.face_verts;
+    for (size_t k = 0; k < _disp_ids.size(); ++k) {
+        const Index v = _disp_ids[k];
+        if (face_only &&
+            !std::binary_search(face_verts.begin(), face_verts.end(), v)) {
+            continue;
+        }
+        if (_disp_space == DisplacementSpace::posed) {
+            out.verts.row(v).noalias() += _disp_offsets.row(k);
+            continue;
+        }
+        out.verts_shaped.row(v).noalias() += _disp_offsets.row(k);
+        // LBS is linear, so the skinned offset is the offset rotated by the
+        // blended rotation of the vertex
+        Eigen::Matrix<Scalar, 3, 3> rot;
+        if (out.vert_transforms.rows()) {
+            rot = TransformMap(out.vert_transforms.row(v).data())
+                      .template leftCols<3>();
+        } else {
+            rot.setZero();
+            for (SparseMatrix::InnerIterator it(model.weights, v); it; ++it) {
+                rot.noalias() +=
+                    it.value() *
+                    TransformMap(out.joint_transforms.row(it.col()).data())
+                        .template leftCols<3>();
+            }
+        }
+        out.verts.row(v).noalias() +=
+            _disp_offsets.row(k) * rot.transpose();
+    }
+}
+
+template <class ModelConfig>
+Vector Body<ModelConfig>::full_pose() const {
+    // Will store full pose params (angle-axis), including hand
+    Vector full_pose(3 * model.n_joints());
 
     // Copy body pose onto full pose
     full_pose.head(3 * model.n_explicit_joints()).noalias() = pose();
     if (model.n_hand_pca_joints() > 0) {
+        model.require(ModelComponent::hand_pca);
         // Use hand PCA weights to fill in hand pose within full pose
         full_pose
             .segment(3 * model.n_explicit_joints(),
@@ -99,139 +924,95 @@ void Body<ModelConfig>::update(bool force_cpu, bool enable_pose_blendshapes) {
         full_pose.tail(3 * model.n_hand_pca_joints()).noalias() =
             model.hand_mean_r + model.hand_comps_r * hand_pca_r();
     }
+    return full_pose;
+}
 
-    // Copy shape params to blendshape params
-    blendshape_params.head<ModelConfig::n_shape_blends()>() = shape();
-
-    // Convert angle-axis to rotation matrix using rodrigues
-    TransformMap(_joint_transforms.topRows<1>().data())
-        .template leftCols<3>()
-        .noalias() = util::rodrigues<float>(full_pose.head<3>());
-    for (size_t i = 1; i < model.n_joints(); ++i) {
-        TransformMap joint_trans(_joint_transforms.row(i).data());
-        joint_trans.template leftCols<3>().noalias() =
-            util::rodrigues<float>(full_pose.segment<3>(3 * i));
-        RotationMap mp(blendshape_params.data() + 9 * i +
-                       (model.n_shape_blends() - 9));
-        mp.noalias() = joint_trans.template leftCols<3>();
-        mp.diagonal().array() -= 1.f;
-    }
-
-#ifdef SMPLX_CUDA_ENABLED
-    _last_update_used_gpu = !force_cpu;
-    if (!force_cpu) {
-        _cuda_update(blendshape_params.data(), _joint_transforms.data(),
-                     enable_pose_blendshapes);
-        _vert_transforms.resize(0, 12);
-        return;
+template <class ModelConfig>
+void Body<ModelConfig>::_compute_normals(Buffer& out,
+                                         size_t n_threads) const {
+    const Points& cur_verts = out.verts;
+    const auto cur_faces = _faces(out);
+    const auto vert_faces = _vert_faces(out);
+    const size_t n_faces = cur_faces.rows(), n_verts = cur_verts.rows();
+    out.face_normals.resize(n_faces, 3);
+    out.normals.resize(n_verts, 3);
+    const auto& kernels = internal::cpu_kernels();
+    auto face_pass = [&](size_t begin, size_t end) {
+        kernels.face_normals(cur_verts.data(), cur_faces.data(),
+                             out.face_normals.data(), begin, end);
+    };
+    // Gather through the vertex-face adjacency; no scatter, so vertex
+    // ranges are independent
+    auto vert_pass = [&](size_t begin, size_t end) {
+        kernels.vert_normals(vert_faces.outerIndexPtr(),
+                             vert_faces.innerIndexPtr(),
+                             out.face_normals.data(), out.normals.data(),
+                             begin, end);
+    };
+    if (n_threads == 1) {
+        face_pass(0, n_faces);
+        vert_pass(0, n_verts);
+    } else {
+        auto& pool = ThreadPool::global();
+        pool.parallel_for(n_faces, face_pass, n_threads);
+        pool.parallel_for(n_verts, vert_pass, n_threads);
     }
-#endif
-
-    // _SMPLX_PROFILE(preproc);
-    // Apply blend shapes
-    {
-        Eigen::Map<Eigen::Matrix<Scalar, Eigen::Dynamic, 1>> verts_shaped_flat(
-            _verts_shaped.data(), model.n_verts() * 3);
-        Eigen::Map<const Eigen::Matrix<Scalar, Eigen::Dynamic, 1>>
-            verts_init_flat(model.verts.data(), model.n_verts() * 3);
-        // Add shape blend shapes
-        verts_shaped_flat.noalias() =
-            verts_init_flat +
-            model.blend_shapes
-                    .template leftCols<ModelConfig::n_shape_blends()>() *
-                blendshape_params.head<ModelConfig::n_shape_blends()>();
-    }
-    // _SMPLX_PROFILE(blendshape);
-
-    // Apply joint regressor
-    _joints_shaped = model.joint_reg * _verts_shaped;
+}
 
-    if (enable_pose_blendshapes) {
-        // HORRIBLY SLOW, like 95% of the time is spent here yikes
-        // Add pose blend shapes
-        Eigen::Map<Eigen::Matrix<Scalar, Eigen::Dynamic, 1>> verts_shaped_flat(
-            _verts_shaped.data(), model.n_verts() * 3);
-        verts_shaped_flat +=
-            model.blend_shapes
-                .template rightCols<ModelConfig::n_pose_blends()>() *
-            blendshape_params.tail<ModelConfig::n_pose_blends()>();
-    }
-
-    // Inputs: trans(), _joints_shaped
-    // Outputs: _joints
-    // Input/output: _joint_transforms
-    //   (input: left 3x3 should be local rotation mat for joint
-    //    output: completed joint local space transform rel global)
-    _local_to_global();
-    // _SMPLX_PROFILE(localglobal);
-
-    // * LBS *
-    // Construct a transform for each vertex
-    _vert_transforms.noalias() = model.weights * _joint_transforms;
-    // _SMPLX_PROFILE(lbs weight computation);
-
-    // Apply affine transform to each vertex and store to output
-    // #pragma omp parallel for // Seems to only make it slower??
-    for (size_t i = 0; i < model.n_verts(); ++i) {
-        TransformTransposedMap transform_tr(_vert_transforms.row(i).data());
-        _verts.row(i).noalias() =
-            _verts_shaped.row(i).homogeneous() * transform_tr;
-    }
-    // _SMPLX_PROFILE(lbs point transform);
-}
-
-template <class ModelConfig>
-void Body<ModelConfig>::_local_to_global() {
-    _joints.resize(ModelConfig::n_joints(), 3);
-    using TransformMap =
-        Eigen::Map<Eigen::Matrix<Scalar, 3, 4, Eigen::RowMajor>>;
-    using TransformTransposedMap = Eigen::Map<Eigen::Matrix<Scalar, 4, 3>>;
-    // Handle root joint transforms
-    TransformTransposedMap root_transform_tr(
-        _joint_transforms.topRows<1>().data());
-    root_transform_tr.bottomRows<1>().noalias() =
-        _joints_shaped.topRows<1>() + trans().transpose();
-    _joints.topRows<1>().noalias() = root_transform_tr.bottomRows<1>();
-
-    // Complete the affine transforms for all other joint by adding translation
-    // components and composing with parent
-    for (int i = 1; i < ModelConfig::n_joints(); ++i) {
-        TransformMap transform(_joint_transforms.row(i).data());
-        const auto p = ModelConfig::parent[i];
-        // Set relative translation
-        transform.rightCols<1>().noalias() =
-            (_joints_shaped.row(i) - _joints_shaped.row(p)).transpose();
-        // Compose rotation with parent
-        util::mul_affine<float, Eigen::RowMajor>(
-            TransformMap(_joint_transforms.row(p).data()), transform);
-        // Grab the joint position in case the user wants it
-        _joints.row(i).noalias() = transform.rightCols<1>().transpose();
-    }
-
-    for (int i = 0; i < ModelConfig::n_joints(); ++i) {
-        TransformTransposedMap transform_tr(_joint_transforms.row(i).data());
-        // Translate to center at global origin
-        transform_tr.bottomRows<1>().noalias() -=
-            _joints_shaped.row(i) * transform_tr.topRows<3>();
+template <class ModelConfig>
+void Body<ModelConfig>::_compute_normals_local(
+    Buffer& out, const std::vector<Index>& moved_verts) const {
+    const Points& cur_verts = out.verts;
+    const auto& kernels = internal::cpu_kernels();
+    const int* outer = model.vert_faces.outerIndexPtr();
+    const int* inner = model.vert_faces.innerIndexPtr();
+    // Faces touching a moved vertex
+    std::vector<Index> touched_faces;
+    for (Index v : moved_verts) {
+        touched_faces.insert(touched_faces.end(), inner + outer[v],
+                             inner + outer[v + 1]);
+    }
+    std::sort(touched_faces.begin(), touched_faces.end());
+    touched_faces.erase(
+        std::unique(touched_faces.begin(), touched_faces.end()),
+        touched_faces.end());
+    // Vertices of those faces are the ones whose normals change
+    std::vector<Index> touched_verts;
+    touched_verts.reserve(touched_faces.size() * 3);
+    for (Index f : touched_faces) {
+        kernels.face_normals(cur_verts.data(), model.faces.data(),
+                             out.face_normals.data(), f, f + 1);
+        for (size_t j = 0; j < 3; ++j) {
+            touched_verts.push_back(model.faces(f, j));
+        }
+    }
+    std::sort(touched_verts.begin(), touched_verts.end());
+    touched_verts.erase(
+        std::unique(touched_verts.begin(), touched_verts.end()),
+        touched_verts.end());
+    for (Index v : touched_verts) {
+        kernels.vert_normals(outer, inner, out.face_normals.data(),
+                             out.normals.data(), v, v + 1);
     }
 }
 
 template <class ModelConfig>
 void Body<ModelConfig>::save_obj(const std::string& path) const {
     const auto& cur_verts = verts();
+    const auto& cur_faces = faces();
     if (cur_verts.rows() == 0) return;
     std::ofstream ofs(path);
     ofs << "# Generated by SMPL-X_cpp"
         << "\n";
     ofs << std::fixed << std::setprecision(6) << "o smplx\n";
-    for (int i = 0; i < model.n_verts(); ++i) {
+    for (int i = 0; i < cur_verts.rows(); ++i) {
         ofs << "v " << cur_verts(i, 0) << " " << cur_verts(i, 1) << " "
             << cur_verts(i, 2) << "\n";
     }
     ofs << "s 1\n";
-    for (int i = 0; i < model.n_faces(); ++i) {
-        ofs << "f " << model.faces(i, 0) + 1 << " " << model.faces(i, 1) + 1
-            << " " << model.faces(i, 2) + 1 << "\n";
+    for (int i = 0; i < cur_faces.rows(); ++i) {
+        ofs << "f " << cur_faces(i, 0) + 1 << " " << cur_faces(i, 1) + 1
+            << " " << cur_faces(i, 2) + 1 << "\n";
     }
     ofs.close();
 }
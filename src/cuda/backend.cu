@@ -0,0 +1,319 @@
+#include <iostream>
+
+#include "smplx/smplx.hpp"
+#include "smplx/util.hpp"
+#include "smplx/internal/backend.hpp"
+#include "smplx/internal/cpu_kernels.hpp"
+#include "smplx/internal/cuda_util.cuh"
+
+namespace smplx {
+namespace internal {
+namespace {
+using cuda_util::device::BLOCK_SIZE;
+using cuda_util::from_host_eigen_sparse_matrix;
+using cuda_util::from_host_eigen_matrix;
+
+namespace device {
+/** Joint regressor: multiples sparse matrix in CSR represented by
+ *  (model_jr_values(nnz), ..inner(nnz), ..outer(#joints+1)) to
+ *  d_verts_shaped(#verts,3) row-major
+ *  -> outputs to out(#joints, 3) row-major
+ *  TODO: Optimize. The matrix is very wide and this is not efficient */
+__global__ void joint_regressor(float* RESTRICT d_verts_shaped, float* RESTRICT model_jr_values,
+                                int* RESTRICT model_jr_inner, int* RESTRICT model_jr_outer,
+                                float* RESTRICT out_joints) {
+    const int joint = threadIdx.y, idx = threadIdx.x;
+    out_joints[joint * 3 + idx] = 0.f;
+    for (int i = model_jr_outer[joint]; i < model_jr_outer[joint + 1]; ++i) {
+        out_joints[joint * 3 + idx] +=
+            model_jr_values[i] * d_verts_shaped[model_jr_inner[i] * 3 + idx];
+    }
+}
+
+/** Linear blend skinning kernel.
+  * d_joint_global_transform (#joints, 12) row-major;
+  *   global-space homogeneous transforms (bottom row dropped)
+  *   at each joint from local_to_global
+  * d_points_shaped (#points, 3) row-major; vertices after blendshapes applied
+  * (model_weights_values(nnz), ..inner(nnz), ..outer(#joints+1)) sparse LBS weights in CSR
+  * -> out_verts(#points, 3) resulting vertices after deformation */
+__global__ void lbs(float* RESTRICT d_joint_global_transform, float* RESTRICT d_verts_shaped,
+                    float* RESTRICT model_weights_values, int* RESTRICT model_weights_inner,
+                    int* RESTRICT model_weights_outer,
+                    float* RESTRICT out_verts,  // transformed joint pos
+                    const int n_joints, const int n_verts) {
+    const int vert = blockDim.x * blockIdx.x + threadIdx.x;  // Vert idx
+    if (vert < n_verts) {
+        for (int i = 0; i < 3; ++i) {
+            out_verts[vert * 3 + i] = 0.f;
+            for (int joint_it = model_weights_outer[vert];
+                 joint_it < model_weights_outer[vert + 1]; ++joint_it) {
+                const int joint_row_idx =
+                    model_weights_inner[joint_it] * 12 + i * 4;
+                for (int j = 0; j < 3; ++j) {
+                    out_verts[vert * 3 + i] +=
+                        model_weights_values[joint_it] *
+                        d_joint_global_transform[joint_row_idx + j] *
+                        d_verts_shaped[vert * 3 + j];
+                }
+                out_verts[vert * 3 + i] +=
+                    model_weights_values[joint_it] *
+                    d_joint_global_transform[joint_row_idx + 3];
+            }
+        }
+    }
+}
+
+}  // namespace device
+
+__host__ void free_sparse_matrix(GPUSparseMatrix& mat) {
+    if (mat.values) cudaFree(mat.values);
+    if (mat.inner) cudaFree(mat.inner);
+    if (mat.outer) cudaFree(mat.outer);
+    mat.values = nullptr;
+    mat.inner = mat.outer = nullptr;
+}
+
+/** CUDA backend: device copy of the model data */
+template <class ModelConfig>
+class CudaModelBackend : public ModelBackend<ModelConfig> {
+   public:
+    explicit CudaModelBackend(const Model<ModelConfig>& model)
+        : ModelBackend<ModelConfig>(model) {
+        _load();
+    }
+    ~CudaModelBackend() override { _free(); }
+
+    Backend type() const override { return Backend::cuda; }
+
+    void model_loaded() override {
+        _free();
+        _load();
+    }
+
+    void template_changed() override {
+        const auto& model = this->model;
+        const size_t dsize = model.verts.size() * sizeof(model.verts.data()[0]);
+        cudaMemcpy(verts, model.verts.data(), dsize, cudaMemcpyHostToDevice);
+    }
+
+    std::unique_ptr<BodyBackend<ModelConfig>> create_body() const override;
+
+    float* verts = nullptr;
+    float* blend_shapes = nullptr;
+    GPUSparseMatrix joint_reg;
+    GPUSparseMatrix weights;
+
+   private:
+    __host__ void _load() {
+        const auto& model = this->model;
+        model.require(
+            {ModelComponent::shape_blends, ModelComponent::pose_blends});
+        from_host_eigen_matrix(verts, model.verts);
+        from_host_eigen_matrix(blend_shapes, model.blend_shapes);
+        from_host_eigen_sparse_matrix(joint_reg, model.joint_reg);
+        from_host_eigen_sparse_matrix(weights, model.weights);
+    }
+    __host__ void _free() {
+        if (verts) cudaFree(verts);
+        if (blend_shapes) cudaFree(blend_shapes);
+        verts = blend_shapes = nullptr;
+        free_sparse_matrix(joint_reg);
+        free_sparse_matrix(weights);
+    }
+};
+
+/** CUDA backend: per-body device buffers. Outputs stay on the device until
+ *  retrieved; vertex transforms are left to Body */
+template <class ModelConfig>
+class CudaBodyBackend : public BodyBackend<ModelConfig> {
+   public:
+    explicit CudaBodyBackend(const CudaModelBackend<ModelConfig>& data)
+        : data(data),
+          model(data.model),
+          blendshape_params(model.n_blend_shapes()) {
+        cudaMalloc((void**)&device.verts, model.n_verts() * 3 * sizeof(float));
+        cudaMalloc((void**)&device.blendshape_params,
+                   model.n_blend_shapes() * sizeof(float));
+        cudaMalloc((void**)&device.joint_transforms,
+                   model.n_joints() * 12 * sizeof(float));
+        cudaMalloc((void**)&device.verts_shaped,
+                   model.n_verts() * 3 * sizeof(float));
+        cudaMalloc((void**)&device.joints_shaped,
+                   model.n_joints() * 3 * sizeof(float));
+    }
+
+    ~CudaBodyBackend() override {
+        if (device.verts) cudaFree(device.verts);
+        if (device.blendshape_params) cudaFree(device.blendshape_params);
+        if (device.joint_transforms) cudaFree(device.joint_transforms);
+        if (device.verts_shaped) cudaFree(device.verts_shaped);
+        if (device.joints_shaped) cudaFree(device.joints_shaped);
+    }
+
+    __host__ void update(const Vector& full_pose,
+                         const Eigen::Ref<const Vector>& shape,
+                         const Eigen::Ref<const Vector3f>& trans,
+                         const Points* template_offsets,
+                         bool enable_pose_blendshapes,
+                         BodyOutputs& out) override {
+        using TransformMap =
+            Eigen::Map<Eigen::Matrix<Scalar, 3, 4, Eigen::RowMajor>>;
+        using RotationMap =
+            Eigen::Map<Eigen::Matrix<Scalar, 3, 3, Eigen::RowMajor>>;
+        // Verts will be updated
+        verts_retrieved = false;
+        verts_shaped_retrieved = false;
+        out.joints_shaped.resize(model.n_joints(), 3);
+        out.joint_transforms.resize(model.n_joints(), 12);
+        out.vert_transforms.resize(0, 12);
+
+        // Rotations and blend shape params are computed on the host
+        blendshape_params.head(model.n_shape_blends()) = shape;
+        cpu_kernels().rodrigues(full_pose.data(), out.joint_transforms.data(),
+                                model.n_joints());
+        for (size_t i = 1; i < model.n_joints(); ++i) {
+            TransformMap joint_trans(out.joint_transforms.row(i).data());
+            RotationMap mp(blendshape_params.data() + 9 * i +
+                           (model.n_shape_blends() - 9));
+            mp.noalias() = joint_trans.template leftCols<3>();
+            mp.diagonal().array() -= 1.f;
+        }
+
+        // Copy parameters to GPU
+        cudaCheck(cudaMemcpyAsync(device.blendshape_params,
+                                  blendshape_params.data(),
+                                  model.n_blend_shapes() * sizeof(float),
+                                  cudaMemcpyHostToDevice));
+        // Shape blendshapes, on the personalized template if any
+        if (template_offsets) {
+            verts_template.noalias() = model.verts + *template_offsets;
+            cudaCheck(cudaMemcpyAsync(device.verts_shaped,
+                                      verts_template.data(),
+                                      model.n_verts() * 3 * sizeof(float),
+                                      cudaMemcpyHostToDevice));
+        } else {
+            cudaCheck(cudaMemcpyAsync(device.verts_shaped, data.verts,
+                                      model.n_verts() * 3 * sizeof(float),
+                                      cudaMemcpyDeviceToDevice));
+        }
+        cuda_util::mmv_block<float, true>(
+            data.blend_shapes, device.blendshape_params, device.verts_shaped,
+            ModelConfig::n_verts() * 3, model.n_shape_blends());
+
+        // Joint regressor
+        // TODO: optimize sparse matrix multiplication, maybe use ELL format
+        dim3 jr_blocks(3, model.n_joints());
+        device::joint_regressor<<<1, jr_blocks>>>(
+            device.verts_shaped, data.joint_reg.values, data.joint_reg.inner,
+            data.joint_reg.outer, device.joints_shaped);
+
+        if (enable_pose_blendshapes) {
+            // Pose blendshapes.
+            // Note: this is the most expensive operation.
+            cuda_util::mmv_block<float, true>(
+                data.blend_shapes +
+                    model.n_shape_blends() * 3 * ModelConfig::n_verts(),
+                device.blendshape_params + model.n_shape_blends(),
+                device.verts_shaped, ModelConfig::n_verts() * 3,
+                ModelConfig::n_pose_blends());
+        }
+
+        // Compute global joint transforms, this part can't be parallized and
+        // is horribly slow on GPU; we do it on CPU instead
+        // Actually, this is pretty bad too, TODO try implementing on GPU again
+        cudaCheck(cudaMemcpyAsync(out.joints_shaped.data(),
+                                  device.joints_shaped,
+                                  model.n_joints() * 3 * sizeof(float),
+                                  cudaMemcpyDeviceToHost));
+        local_to_global<ModelConfig>(trans, out);
+        cudaCheck(cudaMemcpyAsync(
+            device.joint_transforms, out.joint_transforms.data(),
+            out.joint_transforms.size() * sizeof(float),
+            cudaMemcpyHostToDevice));
+
+        // weights: (#verts, #joints)
+        device::lbs<<<(model.verts.size() - 1) / BLOCK_SIZE + 1, BLOCK_SIZE>>>(
+            device.joint_transforms, device.verts_shaped, data.weights.values,
+            data.weights.inner, data.weights.outer, device.verts,
+            model.n_joints(), model.n_verts());
+    }
+
+    __host__ void retrieve_verts(BodyOutputs& out) override {
+        if (!verts_retrieved) {
+            out.verts.resize(model.n_verts(), 3);
+            cudaMemcpy(out.verts.data(), device.verts,
+                       out.verts.size() * sizeof(float),
+                       cudaMemcpyDeviceToHost);
+            verts_retrieved = true;
+        }
+    }
+
+    __host__ void retrieve_verts_shaped(BodyOutputs& out) override {
+        if (!verts_shaped_retrieved) {
+            out.verts_shaped.resize(model.n_verts(), 3);
+            cudaMemcpy(out.verts_shaped.data(), device.verts_shaped,
+                       out.verts_shaped.size() * sizeof(float),
+                       cudaMemcpyDeviceToHost);
+            verts_shaped_retrieved = true;
+        }
+    }
+
+   private:
+    const CudaModelBackend<ModelConfig>& data;
+    const Model<ModelConfig>& model;
+    // Shape params + pose blend shape params, host copy
+    Vector blendshape_params;
+    struct {
+        float* verts = nullptr;
+        float* verts_shaped = nullptr;
+        float* joints_shaped = nullptr;
+        // Internal (#total blend shapes) rm
+        float* blendshape_params = nullptr;
+        // Internal (#joints, 12) rm
+        float* joint_transforms = nullptr;
+    } device;
+    // model.verts + template offsets, host copy
+    Points verts_template;
+    // True if latest posed vertices constructed by update()
+    // have been retrieved to main memory
+    bool verts_retrieved = true;
+    // True if latest shaped, unposed vertices constructed by update()
+    // have been retrieved to main memory
+    bool verts_shaped_retrieved = true;
+};
+
+template <class ModelConfig>
+std::unique_ptr<BodyBackend<ModelConfig>>
+CudaModelBackend<ModelConfig>::create_body() const {
+    return std::unique_ptr<BodyBackend<ModelConfig>>(
+        new CudaBodyBackend<ModelConfig>(*this));
+}
+
+}  // namespace
+
+template <class ModelConfig>
+std::unique_ptr<ModelBackend<ModelConfig>> create_cuda_model_backend(
+    const Model<ModelConfig>& model) {
+    return std::unique_ptr<ModelBackend<ModelConfig>>(
+        new CudaModelBackend<ModelConfig>(model));
+}
+
+// Instantiation
+template std::unique_ptr<ModelBackend<model_config::SMPL>>
+create_cuda_model_backend(const Model<model_config::SMPL>&);
+template std::unique_ptr<ModelBackend<model_config::SMPL_v1>>
+create_cuda_model_backend(const Model<model_config::SMPL_v1>&);
+template std::unique_ptr<ModelBackend<model_config::SMPLH>>
+create_cuda_model_backend(const Model<model_config::SMPLH>&);
+template std::unique_ptr<ModelBackend<model_config::SMPLX>>
+create_cuda_model_backend(const Model<model_config::SMPLX>&);
+template std::unique_ptr<ModelBackend<model_config::SMPLXpca>>
+create_cuda_model_backend(const Model<model_config::SMPLXpca>&);
+template std::unique_ptr<ModelBackend<model_config::SMPLX_v1>>
+create_cuda_model_backend(const Model<model_config::SMPLX_v1>&);
+template std::unique_ptr<ModelBackend<model_config::SMPLXpca_v1>>
+create_cuda_model_backend(const Model<model_config::SMPLXpca_v1>&);
+
+}  // namespace internal
+}  // namespace smplx
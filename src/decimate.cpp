@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+
+#include "smplx/util.hpp"
+
+namespace smplx {
+namespace util {
+namespace {
+
+using Quadric = Eigen::Matrix4d;
+using Vector3d = Eigen::Vector3d;
+
+// Weight of the planes keeping boundary edges in place, relative to faces
+const double BOUNDARY_PENALTY = 100.0;
+
+// Candidate half-edge collapse from -> to, valid while both stamps match
+struct Collapse {
+    double cost;
+    Index from, to;
+    uint32_t from_stamp, to_stamp;
+    bool operator>(const Collapse& other) const { return cost > other.cost; }
+};
+
+inline void add_plane(Quadric& q, const Vector3d& normal, double d,
+                      double weight) {
+    const Eigen::Vector4d plane(normal.x(), normal.y(), normal.z(), d);
+    q.noalias() += weight * plane * plane.transpose();
+}
+
+}  // namespace
+
+void decimate_mesh(const Points& verts,
+                   const Eigen::Ref<const Triangles>& faces,
+                   size_t target_verts, std::vector<Index>& kept_verts,
+                   Triangles& out_faces) {
+    const size_t n_verts = verts.rows(), n_faces = faces.rows();
+    Triangles cur_faces = faces;
+    std::vector<char> face_alive(n_faces, 1), vert_alive(n_verts, 1);
+    std::vector<std::vector<Index>> vert_faces(n_verts);
+    std::vector<Quadric> quadrics(n_verts, Quadric::Zero());
+    std::vector<uint32_t> stamp(n_verts);
+
+    auto pos = [&](Index v) -> Vector3d {
+        return verts.row(v).transpose().cast<double>();
+    };
+    auto normal = [&](const Vector3d& a, const Vector3d& b,
+                      const Vector3d& c) -> Vector3d {
+        return (b - a).cross(c - a);
+    };
+
+    // Area-weighted face plane quadrics; boundary edges (used by only one
+    // face) get a heavier plane perpendicular to their face
+    std::unordered_map<uint64_t, int> edge_count;
+    for (size_t f = 0; f < n_faces; ++f) {
+        for (size_t j = 0; j < 3; ++j) {
+            vert_faces[faces(f, j)].push_back(f);
+            const Index a = faces(f, j), b = faces(f, (j + 1) % 3);
+            ++edge_count[(uint64_t)std::min(a, b) << 32 | std::max(a, b)];
+        }
+        const Vector3d n =
+            normal(pos(faces(f, 0)), pos(faces(f, 1)), pos(faces(f, 2)));
+        const double len = n.norm();
+        if (len == 0.0) continue;
+        const Vector3d unit = n / len;
+        for (size_t j = 0; j < 3; ++j) {
+            add_plane(quadrics[faces(f, j)], unit,
+                      -unit.dot(pos(faces(f, 0))), 0.5 * len);
+        }
+    }
+    for (size_t f = 0; f < n_faces; ++f) {
+        const Vector3d n =
+            normal(pos(faces(f, 0)), pos(faces(f, 1)), pos(faces(f, 2)));
+        for (size_t j = 0; j < 3; ++j) {
+            const Index a = faces(f, j), b = faces(f, (j + 1) % 3);
+            if (edge_count[(uint64_t)std::min(a, b) << 32 | std::max(a, b)] !=
+                1) {
+                continue;
+            }
+            const Vector3d edge = pos(b) - pos(a);
+            Vector3d side = edge.cross(n);
+            if (side.norm() == 0.0) continue;
+            side.normalize();
+            const double d = -side.dot(pos(a));
+            add_plane(quadrics[a], side, d,
+                      BOUNDARY_PENALTY * edge.squaredNorm());
+            add_plane(quadrics[b], side, d,
+                      BOUNDARY_PENALTY * edge.squaredNorm());
+        }
+    }
+
+    // Sorted distinct neighbors of v through alive faces
+    auto neighbors = [&](Index v) {
+        std::vector<Index> result;
+        for (Index f : vert_faces[v]) {
+            if (!face_alive[f]) continue;
+            for (size_t j = 0; j < 3; ++j) {
+                if (cur_faces(f, j) != v) result.push_back(cur_faces(f, j));
+            }
+        }
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+        return result;
+    };
+
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>>
+        heap;
+    auto push = [&](Index from, Index to) {
+        const Eigen::Vector4d p = pos(to).homogeneous();
+        const double cost = p.dot((quadrics[from] + quadrics[to]) * p);
+        heap.push(Collapse{cost, from, to, stamp[from], stamp[to]});
+    };
+    for (size_t f = 0; f < n_faces; ++f) {
+        for (size_t j = 0; j < 3; ++j) {
+            // Both directions, each edge seen from both faces
+            push(faces(f, j), faces(f, (j + 1) % 3));
+        }
+    }
+
+    // Collapse from -> to keeps the mesh manifold (link condition) and
+    // does not flip or degenerate the remaining faces around from
+    auto valid = [&](Index from, Index to) {
+        const std::vector<Index> nf = neighbors(from), nt = neighbors(to);
+        if (!std::binary_search(nf.begin(), nf.end(), to)) return false;
+        size_t n_shared = 0;
+        for (Index f : vert_faces[from]) {
+            if (!face_alive[f]) continue;
+            const auto row = cur_faces.row(f);
+            if (row(0) == to || row(1) == to || row(2) == to) {
+                ++n_shared;
+                continue;
+            }
+            Vector3d p[3], q[3];
+            for (size_t j = 0; j < 3; ++j) {
+                p[j] = pos(row(j));
+                q[j] = pos(row(j) == from ? to : row(j));
+            }
+            const Vector3d before = normal(p[0], p[1], p[2]),
+                           after = normal(q[0], q[1], q[2]);
+            if (after.squaredNorm() <= 1e-12 * before.squaredNorm() ||
+                before.dot(after) <= 0.0) {
+                return false;
+            }
+        }
+        std::vector<Index> common;
+        std::set_intersection(nf.begin(), nf.end(), nt.begin(), nt.end(),
+                              std::back_inserter(common));
+        return n_shared > 0 && common.size() == n_shared;
+    };
+
+    size_t n_alive = n_verts;
+    while (n_alive > target_verts && !heap.empty()) {
+        const Collapse top = heap.top();
+        heap.pop();
+        const Index from = top.from, to = top.to;
+        if (!vert_alive[from] || !vert_alive[to] ||
+            top.from_stamp != stamp[from] || top.to_stamp != stamp[to] ||
+            !valid(from, to)) {
+            continue;
+        }
+        for (Index f : vert_faces[from]) {
+            if (!face_alive[f]) continue;
+            auto row = cur_faces.row(f);
+            if (row(0) == to || row(1) == to || row(2) == to) {
+                face_alive[f] = 0;
+                continue;
+            }
+            for (size_t j = 0; j < 3; ++j) {
+                if (row(j) == from) row(j) = to;
+            }
+            vert_faces[to].push_back(f);
+        }
+        vert_faces[from].clear();
+        vert_alive[from] = 0;
+        --n_alive;
+        quadrics[to] += quadrics[from];
+        auto& to_faces = vert_faces[to];
+        to_faces.erase(std::remove_if(to_faces.begin(), to_faces.end(),
+                                      [&](Index f) { return !face_alive[f]; }),
+                       to_faces.end());
+        ++stamp[to];
+        for (Index w : neighbors(to)) {
+            push(to, w);
+            push(w, to);
+        }
+    }
+
+    // Compact
+    std::vector<Index> new_index(n_verts);
+    kept_verts.clear();
+    for (size_t v = 0; v < n_verts; ++v) {
+        if (!vert_alive[v]) continue;
+        new_index[v] = kept_verts.size();
+        kept_verts.push_back(v);
+    }
+    out_faces.resize(std::count(face_alive.begin(), face_alive.end(), 1), 3);
+    for (size_t f = 0, i = 0; f < n_faces; ++f) {
+        if (!face_alive[f]) continue;
+        for (size_t j = 0; j < 3; ++j) {
+            out_faces(i, j) = new_index[cur_faces(f, j)];
+        }
+        ++i;
+    }
+}
+
+}  // namespace util
+}  // namespace smplx
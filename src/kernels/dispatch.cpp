@@ -0,0 +1,97 @@
+#include "smplx/internal/cpu_kernels.hpp"
+
+#include <cctype>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#include <intrin.h>
+#define SMPLX_X86_MSVC
+#elif (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define SMPLX_X86_GNU
+#endif
+
+namespace smplx {
+namespace internal {
+namespace {
+
+#ifdef SMPLX_X86_MSVC
+// Check CPUID feature bits and that the OS saves the needed register state
+bool msvc_cpu_supports(bool avx512) {
+    int regs[4];
+    __cpuid(regs, 0);
+    if (regs[0] < 7) return false;
+    __cpuid(regs, 1);
+    const bool fma = regs[2] & (1 << 12), osxsave = regs[2] & (1 << 27);
+    if (!fma || !osxsave) return false;
+    const unsigned long long xcr0 = _xgetbv(0);
+    __cpuidex(regs, 7, 0);
+    const bool avx2 = regs[1] & (1 << 5);
+    if (!avx2 || (xcr0 & 0x6) != 0x6) return false;
+    if (!avx512) return true;
+    const bool avx512f = regs[1] & (1 << 16),
+               avx512vl = regs[1] & (1u << 31);
+    return avx512f && avx512vl && (xcr0 & 0xe6) == 0xe6;
+}
+#endif
+
+bool cpu_has_avx2() {
+#if defined(SMPLX_X86_GNU)
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#elif defined(SMPLX_X86_MSVC)
+    return msvc_cpu_supports(false);
+#else
+    return false;
+#endif
+}
+
+bool cpu_has_avx512() {
+#if defined(SMPLX_X86_GNU)
+    return cpu_has_avx2() && __builtin_cpu_supports("avx512f") &&
+           __builtin_cpu_supports("avx512vl");
+#elif defined(SMPLX_X86_MSVC)
+    return msvc_cpu_supports(true);
+#else
+    return false;
+#endif
+}
+
+const CpuKernels& pick_kernels() {
+    const CpuKernels* avx512 =
+        cpu_has_avx512() ? cpu_kernels_avx512() : nullptr;
+    const CpuKernels* avx2 = cpu_has_avx2() ? cpu_kernels_avx2() : nullptr;
+
+    const char* env = std::getenv("SMPLX_CPU_ISA");
+    if (env && *env) {
+        std::string isa = env;
+        for (auto& c : isa) c = std::tolower(c);
+        const CpuKernels* forced = nullptr;
+        if (isa == "scalar") {
+            forced = cpu_kernels_scalar();
+        } else if (isa == "avx2") {
+            forced = avx2;
+        } else if (isa == "avx512") {
+            forced = avx512;
+        }
+        if (forced) return *forced;
+        std::cerr << "WARNING: SMPLX_CPU_ISA='" << env
+                  << "' is unknown, not compiled in or not supported by this "
+                     "CPU; ignoring\n";
+    }
+    if (avx512) return *avx512;
+    if (avx2) return *avx2;
+    return *cpu_kernels_scalar();
+}
+
+}  // namespace
+
+const CpuKernels& cpu_kernels() {
+    static const CpuKernels& kernels = pick_kernels();
+    return kernels;
+}
+
+}  // namespace internal
+}  // namespace smplx
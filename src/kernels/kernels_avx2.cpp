@@ -0,0 +1,21 @@
+// AVX2 + FMA kernel variant, compiled with AVX2 target flags when
+// SMPLX_BUILD_ISA_VARIANTS is on (see CMakeLists.txt)
+#include "smplx/internal/cpu_kernels.hpp"
+
+#ifdef __AVX2__
+#define SMPLX_KERNELS_NS avx2
+#define SMPLX_KERNELS_NAME "avx2"
+#include "kernels_impl.hpp"
+#endif
+
+namespace smplx {
+namespace internal {
+const CpuKernels* cpu_kernels_avx2() {
+#ifdef __AVX2__
+    return &avx2::kernels;
+#else
+    return nullptr;
+#endif
+}
+}  // namespace internal
+}  // namespace smplx
@@ -0,0 +1,21 @@
+// AVX-512 kernel variant, compiled with AVX-512 target flags when
+// SMPLX_BUILD_ISA_VARIANTS is on (see CMakeLists.txt)
+#include "smplx/internal/cpu_kernels.hpp"
+
+#ifdef __AVX512F__
+#define SMPLX_KERNELS_NS avx512
+#define SMPLX_KERNELS_NAME "avx512"
+#include "kernels_impl.hpp"
+#endif
+
+namespace smplx {
+namespace internal {
+const CpuKernels* cpu_kernels_avx512() {
+#ifdef __AVX512F__
+    return &avx512::kernels;
+#else
+    return nullptr;
+#endif
+}
+}  // namespace internal
+}  // namespace smplx
@@ -0,0 +1,143 @@
+// CPU kernel implementations, included once per instruction set variant by
+// kernels_*.cpp with SMPLX_KERNELS_NS and SMPLX_KERNELS_NAME defined.
+// The variants are compiled with different target flags, so everything here
+// must be plain loops: no Eigen and no inline library templates, which the
+// linker could otherwise merge across variants.
+#include <math.h>
+
+#include "smplx/internal/cpu_kernels.hpp"
+
+#ifndef RESTRICT
+#define RESTRICT __restrict
+#endif
+
+namespace smplx {
+namespace internal {
+namespace SMPLX_KERNELS_NS {
+namespace {
+
+// Rows per block in gemv, so the block of y stays in L1 while
+// columns are streamed through
+const size_t GEMV_ROW_BLOCK = 2048;
+
+void gemv(const float* a, size_t lda, const float* x, float* y,
+          size_t n_cols, size_t row_begin, size_t row_end) {
+    for (size_t rb = row_begin; rb < row_end; rb += GEMV_ROW_BLOCK) {
+        const size_t re =
+            rb + GEMV_ROW_BLOCK < row_end ? rb + GEMV_ROW_BLOCK : row_end;
+        float* RESTRICT yb = y;
+        size_t k = 0;
+        for (; k + 4 <= n_cols; k += 4) {
+            const float x0 = x[k], x1 = x[k + 1], x2 = x[k + 2],
+                        x3 = x[k + 3];
+            // Pose blend params of joints at rest are exactly zero
+            if (x0 == 0.f && x1 == 0.f && x2 == 0.f && x3 == 0.f) continue;
+            const float* RESTRICT a0 = a + k * lda;
+            const float* RESTRICT a1 = a0 + lda;
+            const float* RESTRICT a2 = a1 + lda;
+            const float* RESTRICT a3 = a2 + lda;
+            for (size_t r = rb; r < re; ++r) {
+                yb[r] += x0 * a0[r] + x1 * a1[r] + x2 * a2[r] + x3 * a3[r];
+            }
+        }
+        for (; k < n_cols; ++k) {
+            const float xk = x[k];
+            if (xk == 0.f) continue;
+            const float* RESTRICT ak = a + k * lda;
+            for (size_t r = rb; r < re; ++r) {
+                yb[r] += xk * ak[r];
+            }
+        }
+    }
+}
+
+void rodrigues(const float* aa, float* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        const float* v = aa + i * 3;
+        float* o = out + i * 12;
+        const float theta = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        if (fabsf(theta) < 1e-5f) {
+            o[0] = o[5] = o[10] = 1.f;
+            o[1] = o[2] = o[4] = o[6] = o[8] = o[9] = 0.f;
+            continue;
+        }
+        const float c = cosf(theta), s = sinf(theta), t = 1.f - c;
+        const float x = v[0] / theta, y = v[1] / theta, z = v[2] / theta;
+        o[0] = c + t * x * x;
+        o[1] = t * x * y - s * z;
+        o[2] = t * x * z + s * y;
+        o[4] = t * x * y + s * z;
+        o[5] = c + t * y * y;
+        o[6] = t * y * z - s * x;
+        o[8] = t * x * z - s * y;
+        o[9] = t * y * z + s * x;
+        o[10] = c + t * z * z;
+    }
+}
+
+void lbs(const int* w_outer, const int* w_inner, const float* w_values,
+         const float* joint_transforms, const float* verts_in,
+         float* verts_out, float* vert_transforms, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+        float t[12] = {0.f};
+        for (int k = w_outer[i]; k < w_outer[i + 1]; ++k) {
+            const float w = w_values[k];
+            const float* RESTRICT jt = joint_transforms + w_inner[k] * 12;
+            for (int c = 0; c < 12; ++c) t[c] += w * jt[c];
+        }
+        if (vert_transforms) {
+            float* vt = vert_transforms + i * 12;
+            for (int c = 0; c < 12; ++c) vt[c] = t[c];
+        }
+        const float* v = verts_in + i * 3;
+        float* o = verts_out + i * 3;
+        for (int r = 0; r < 3; ++r) {
+            o[r] = t[r * 4] * v[0] + t[r * 4 + 1] * v[1] + t[r * 4 + 2] * v[2] +
+                   t[r * 4 + 3];
+        }
+    }
+}
+
+void face_normals(const float* verts, const uint32_t* faces,
+                  float* face_normals, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+        const float* a = verts + faces[i * 3] * 3;
+        const float* b = verts + faces[i * 3 + 1] * 3;
+        const float* c = verts + faces[i * 3 + 2] * 3;
+        const float u0 = b[0] - a[0], u1 = b[1] - a[1], u2 = b[2] - a[2];
+        const float v0 = c[0] - a[0], v1 = c[1] - a[1], v2 = c[2] - a[2];
+        float* o = face_normals + i * 3;
+        o[0] = u1 * v2 - u2 * v1;
+        o[1] = u2 * v0 - u0 * v2;
+        o[2] = u0 * v1 - u1 * v0;
+    }
+}
+
+void vert_normals(const int* vf_outer, const int* vf_inner,
+                  const float* face_normals, float* normals, size_t begin,
+                  size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+        float n0 = 0.f, n1 = 0.f, n2 = 0.f;
+        for (int k = vf_outer[i]; k < vf_outer[i + 1]; ++k) {
+            const float* fn = face_normals + vf_inner[k] * 3;
+            n0 += fn[0];
+            n1 += fn[1];
+            n2 += fn[2];
+        }
+        const float len = sqrtf(n0 * n0 + n1 * n1 + n2 * n2);
+        const float inv_len = len > 0.f ? 1.f / len : 0.f;
+        float* o = normals + i * 3;
+        o[0] = n0 * inv_len;
+        o[1] = n1 * inv_len;
+        o[2] = n2 * inv_len;
+    }
+}
+
+}  // namespace
+
+const CpuKernels kernels = {SMPLX_KERNELS_NAME, gemv,         rodrigues,
+                            lbs,                face_normals, vert_normals};
+
+}  // namespace SMPLX_KERNELS_NS
+}  // namespace internal
+}  // namespace smplx
@@ -0,0 +1,10 @@
+// Baseline kernel variant, compiled with the default target flags
+#define SMPLX_KERNELS_NS scalar
+#define SMPLX_KERNELS_NAME "scalar"
+#include "kernels_impl.hpp"
+
+namespace smplx {
+namespace internal {
+const CpuKernels* cpu_kernels_scalar() { return &scalar::kernels; }
+}  // namespace internal
+}  // namespace smplx
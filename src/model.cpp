@@ -1,10 +1,17 @@
 #include "smplx/smplx.hpp"
 
 #include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <fstream>
+#include <iostream>
+#include <new>
+#include <stdexcept>
 #include <cnpy.h>
 
+#include "smplx/internal/npz.hpp"
+#include "smplx/internal/shared_array.hpp"
+#include "smplx/internal/uv_map.hpp"
 #include "smplx/util.hpp"
 #include "smplx/util_cnpy.hpp"
 #include "smplx/version.hpp"
@@ -12,31 +19,106 @@
 namespace smplx {
 namespace {
 using util::assert_shape;
+
+// Vertex-face adjacency of a triangle mesh, (n_verts, #faces) CSR
+SparseMatrix vert_face_adjacency(const Eigen::Ref<const Triangles>& faces,
+                                 size_t n_verts) {
+    std::vector<Eigen::Triplet<Scalar, int>> vf_triplets;
+    vf_triplets.reserve(faces.rows() * 3);
+    for (size_t i = 0; i < faces.rows(); ++i) {
+        for (size_t j = 0; j < 3; ++j) {
+            vf_triplets.emplace_back(faces(i, j), i, 1.f);
+        }
+    }
+    SparseMatrix result(n_verts, faces.rows());
+    result.setFromTriplets(vf_triplets.begin(), vf_triplets.end());
+    result.makeCompressed();
+    return result;
+}
+
+// Eigen's way to re-seat a Map, here onto data (empty if null)
+template <class T>
+void reseat(Eigen::Map<const T>& map, const std::shared_ptr<const T>& data) {
+    if (data) {
+        new (&map) Eigen::Map<const T>(data->data(), data->rows(),
+                                       data->cols());
+    } else {
+        new (&map) Eigen::Map<const T>(nullptr, 0, map.cols());
+    }
+}
+void reseat(Eigen::Map<const SparseMatrix>& map,
+            const std::shared_ptr<const SparseMatrix>& data) {
+    if (data) {
+        new (&map) Eigen::Map<const SparseMatrix>(
+            data->rows(), data->cols(), data->nonZeros(),
+            data->outerIndexPtr(), data->innerIndexPtr(), data->valuePtr());
+    } else {
+        new (&map) Eigen::Map<const SparseMatrix>(0, 0, 0, nullptr, nullptr,
+                                                  nullptr);
+    }
+}
+
+// Source of Model::generation(), shared by all ModelConfigs
+std::atomic<uint64_t> next_generation{1};
+
+// View value through map, sharing its storage with the other models which
+// have an identical array (see internal::share_array)
+template <class T, class MapType>
+void share(T&& value, std::shared_ptr<const T>& owner, MapType& map) {
+    owner = internal::share_array(std::move(value));
+    reseat(map, owner);
+}
 }  // namespace
 
 template <class ModelConfig>
-Model<ModelConfig>::Model(Gender gender) {
+Model<ModelConfig>::Model(Gender gender)
+    : blend_shapes(nullptr, 0, 0) {
     load(gender);
 }
 
 template <class ModelConfig>
 Model<ModelConfig>::Model(const std::string& path, const std::string& uv_path,
-                          Gender gender) {
+                          Gender gender)
+    : blend_shapes(nullptr, 0, 0) {
     load(path, uv_path, gender);
 }
 
 template <class ModelConfig>
 Model<ModelConfig>::~Model() {
-#ifdef SMPLX_CUDA_ENABLED
-    _cuda_free();
-#endif
+    _unlock_pages();
 }
 
 template <class ModelConfig>
 void Model<ModelConfig>::load(Gender gender) {
-    load(util::find_data_file(std::string(ModelConfig::default_path_prefix) +
-                              util::gender_to_str(gender) + ".npz"),
-         util::find_data_file(ModelConfig::default_uv_path), gender);
+    // Embedded under the file name of the default path
+    const std::string default_path = ModelConfig::default_path_prefix;
+    const std::string name =
+        default_path.substr(default_path.rfind('/') + 1) +
+        util::gender_to_str(gender);
+    for (const std::string& embedded : embedded_names()) {
+        if (embedded != name) continue;
+        // Another ModelConfig may share the name
+        try {
+            load_embedded(name);
+            this->gender = gender;
+            return;
+        } catch (const std::invalid_argument&) {
+        }
+    }
+    const std::string prefix = util::find_data_file(
+        std::string(ModelConfig::default_path_prefix) +
+        util::gender_to_str(gender));
+    const std::string uv_path =
+        util::find_data_file(ModelConfig::default_uv_path);
+    if (internal::smplxbin::is_smplxbin(prefix + ".smplxbin")) {
+        // Another ModelConfig may share the prefix
+        try {
+            load(prefix + ".smplxbin", uv_path, gender);
+            return;
+        } catch (const std::invalid_argument&) {
+        }
+    }
+    load(prefix + ".npz", uv_path, gender);
 }
 
 template <class ModelConfig>
@@ -50,129 +132,901 @@ void Model<ModelConfig>::load(const std::string& path,
                      "README.md?\n";
         return;
     }
-    gender = new_gender;
-    cnpy::npz_t npz = cnpy::npz_load(path);
+    if (internal::smplxbin::is_smplxbin(path)) {
+        // Validated before anything is replaced
+        _load_binary(internal::map_file(path));
+        if (new_gender != Gender::unknown) gender = new_gender;
+    } else {
+        _load_npz(path);
+        gender = new_gender;
+    }
+    _loaded(uv_path);
+}
+
+template <class ModelConfig>
+bool Model<ModelConfig>::load_shared(const std::string& name) {
+    bool counted;
+    _load_binary(internal::attach_shared_image(name, &counted));
+    _loaded("");
+    return counted;
+}
+
+template <class ModelConfig>
+void Model<ModelConfig>::load_embedded(const std::string& name) {
+    _load_binary(internal::embedded_image(name));
+    _loaded("");
+}
+
+template <class ModelConfig>
+void Model<ModelConfig>::publish_shared(const std::string& name) const {
+    internal::smplxbin::Header header;
+    const void* data[internal::smplxbin::n_sections];
+    const uint64_t size = _binary_layout(header, data);
+    internal::publish_shared_image(name, size, [&](char* out) {
+        internal::smplxbin::write_image(header, data, out);
+    });
+}
 
+template <class ModelConfig>
+void Model<ModelConfig>::_loaded(const std::string& uv_path) {
     // Load kintree
-    children.resize(n_joints());
+    children.assign(n_joints(), {});
     for (size_t i = 1; i < n_joints(); ++i) {
         children[ModelConfig::parent[i]].push_back(i);
     }
 
-    // Load base template
-    const auto& verts_raw = npz.at("v_template");
-    assert_shape(verts_raw, {n_verts(), 3});
-    verts.noalias() = util::load_float_matrix(verts_raw, n_verts(), 3);
-    verts_load.noalias() = verts;
-
-    // Load triangle mesh
-    const auto& faces_raw = npz.at("f");
-    assert_shape(faces_raw, {n_faces(), 3});
-    faces = util::load_uint_matrix(faces_raw, n_faces(), 3);
-
-    // Load joint regressor
-    const auto& jreg_raw = npz.at("J_regressor");
-    assert_shape(jreg_raw, {n_joints(), n_verts()});
-    joint_reg.resize(n_joints(), n_verts());
-    joint_reg =
-        util::load_float_matrix(jreg_raw, n_joints(), n_verts()).sparseView();
+    // Build vertex-face adjacency
+    share(vert_face_adjacency(faces, n_verts()), _vert_faces_data,
+          vert_faces);
     joints = joint_reg * verts;
-    joint_reg.makeCompressed();
-
-    // Load LBS weights
-    const auto& wt_raw = npz.at("weights");
-    assert_shape(wt_raw, {n_verts(), n_joints()});
-    weights.resize(n_verts(), n_joints());
-    weights =
-        util::load_float_matrix(wt_raw, n_verts(), n_joints()).sparseView();
-    weights.makeCompressed();
-
-    blend_shapes.resize(3 * n_verts(), n_blend_shapes());
-    // Load shape-dep blend shapes
-    const auto& sb_raw = npz.at("shapedirs");
-    assert_shape(sb_raw, {n_verts(), 3, n_shape_blends()});
-    blend_shapes.template leftCols<n_shape_blends()>().noalias() =
-        util::load_float_matrix(sb_raw, 3 * n_verts(), n_shape_blends());
-
-    // Load pose-dep blend shapes
-    const auto& pb_raw = npz.at("posedirs");
-    assert_shape(pb_raw, {n_verts(), 3, n_pose_blends()});
-    blend_shapes.template rightCols<n_pose_blends()>().noalias() =
-        util::load_float_matrix(pb_raw, 3 * n_verts(), n_pose_blends());
-
-    if (n_hand_pca() && npz.count("hands_meanl") && npz.count("hands_meanr")) {
-        // Model has hand PCA (e.g. SMPLXpca), load hand PCA
-        const auto& hml_raw = npz.at("hands_meanl");
-        const auto& hmr_raw = npz.at("hands_meanr");
-        const auto& hcl_raw = npz.at("hands_componentsl");
-        const auto& hcr_raw = npz.at("hands_componentsr");
-
-        assert_shape(hml_raw, {util::ANY_SHAPE});
-        assert_shape(hmr_raw, {hml_raw.shape[0]});
-
-        size_t n_hand_params = hml_raw.shape[0];
-        _SMPLX_ASSERT_EQ(n_hand_params, n_hand_pca_joints() * 3);
-
-        assert_shape(hcl_raw, {n_hand_params, n_hand_params});
-        assert_shape(hcr_raw, {n_hand_params, n_hand_params});
-
-        hand_mean_l = util::load_float_matrix(hml_raw, n_hand_params, 1);
-        hand_mean_r = util::load_float_matrix(hmr_raw, n_hand_params, 1);
-
-        hand_comps_l =
-            util::load_float_matrix(hcl_raw, n_hand_params, n_hand_params)
-                .topRows(n_hand_pca())
-                .transpose();
-        hand_comps_r =
-            util::load_float_matrix(hcr_raw, n_hand_params, n_hand_params)
-                .topRows(n_hand_pca())
-                .transpose();
-    }
-
-    // Maybe load UV (UV mapping WIP)
-    if (uv_path.size()) {
+
+    // Maybe load UV (UV mapping WIP); only the count is read here
+    _uv_path.clear();
+    if (!_n_uv_verts && uv_path.size()) {
         std::ifstream ifs(uv_path);
-        ifs >> _n_uv_verts;
-        if (_n_uv_verts) {
-            if (ifs) {
-                // _SMPLX_ASSERT_LE(n_verts(), _n_uv_verts);
-                // Load the uv data
-                uv.resize(_n_uv_verts, 2);
-                for (size_t i = 0; i < _n_uv_verts; ++i)
-                    ifs >> uv(i, 0) >> uv(i, 1);
-                _SMPLX_ASSERT(ifs);
-                uv_faces.resize(n_faces(), 3);
+        if (ifs >> _n_uv_verts && _n_uv_verts) {
+            _uv_path = uv_path;
+        } else {
+            _n_uv_verts = 0;
+        }
+    }
+    _uv_to_vert_data.reset();
+    reseat(uv_to_vert, _uv_to_vert_data);
+    _components &= ~_component_bit(ModelComponent::uv_map);
+
+    _data_changed();
+}
+
+template <class ModelConfig>
+void Model<ModelConfig>::_data_changed() {
+    _generation = next_generation++;
+
+    // Derived from the blend shapes, so computed on first use
+    face_verts.clear();
+    face_blend_shapes.resize(0, 0);
+    _components &= ~_component_bit(ModelComponent::face_region);
+
+    // Levels of detail keep their topology and take the new data
+    for (auto& lod : _lods) _gather_lod(*lod);
+
+    std::lock_guard<std::mutex> lock(_backend_mtx);
+    for (auto& data : _backend_data) {
+        if (data) data->model_loaded();
+    }
+}
+
+template <class ModelConfig>
+void Model<ModelConfig>::set_shape_space(size_t n_body_shape,
+                                         size_t n_expression) {
+    _max_body_shape = n_body_shape;
+    _max_expression = n_expression;
+    const size_t n_shape = _n_shape_blends;
+    _truncate_shape_space();
+    if (_n_shape_blends != n_shape) _data_changed();
+}
+
+template <class ModelConfig>
+void Model<ModelConfig>::_truncate_shape_space() {
+    const size_t n_expr_old = _n_expression_blends,
+                 n_body_old = _n_shape_blends - n_expr_old;
+    const size_t n_expr = std::min(_max_expression, n_expr_old),
+                 n_body = std::min(_max_body_shape, n_body_old),
+                 n_shape = n_body + n_expr;
+    if (n_shape == _n_shape_blends) return;
+
+    // The old storage is freed below; pin the new one instead
+    const bool locked = _unlock_pages();
+    // Copy the kept columns which are loaded; the others are loaded into
+    // their new place on first use
+    auto storage = _new_blend_shapes(n_shape + n_pose_blends());
+    Eigen::Map<BlendShapes> data(static_cast<Scalar*>(storage.get()),
+                                 3 * n_verts(), n_shape + n_pose_blends());
+    if (is_loaded(ModelComponent::shape_blends)) {
+        data.leftCols(n_body) = blend_shapes.leftCols(n_body);
+        data.middleCols(n_body, n_expr) =
+            blend_shapes.middleCols(n_body_old, n_expr);
+        MatrixColMajor joint_data(3 * n_joints(), n_shape);
+        joint_data.leftCols(n_body) = joint_shape_blends.leftCols(n_body);
+        joint_data.rightCols(n_expr) =
+            joint_shape_blends.middleCols(n_body_old, n_expr);
+        joint_shape_blends.swap(joint_data);
+    }
+    if (is_loaded(ModelComponent::pose_blends)) {
+        data.rightCols(n_pose_blends()) =
+            blend_shapes.rightCols(n_pose_blends());
+    }
+    _blend_shapes_storage = std::move(storage);
+    _n_shape_blends = n_shape;
+    _n_expression_blends = n_expr;
+    _set_blend_shapes(static_cast<Scalar*>(_blend_shapes_storage.get()));
+    // No longer used if mapped
+    _image_owner.reset();
+    if (locked) _prefault_pages(true);
+}
+
+template <class ModelConfig>
+void Model<ModelConfig>::require(ModelComponent component) const {
+    if (is_loaded(component)) return;
+    std::lock_guard<std::mutex> lock(
+        _component_mtx[static_cast<size_t>(component)]);
+    _load_component(component);
+}
+
+template <class ModelConfig>
+void Model<ModelConfig>::require(
+    std::initializer_list<ModelComponent> components) const {
+    std::vector<std::function<void()>> tasks;
+    for (ModelComponent component : components) {
+        if (is_loaded(component)) continue;
+        tasks.push_back([this, component]() { require(component); });
+    }
+    internal::NpzReader::run_concurrently(tasks);
+}
+
+template <class ModelConfig>
+void Model<ModelConfig>::preload() const {
+    require({ModelComponent::shape_blends, ModelComponent::pose_blends,
+             ModelComponent::hand_pca, ModelComponent::uv_map});
+    require(ModelComponent::face_region);
+}
+
+template <class ModelConfig>
+void Model<ModelConfig>::_load_component(ModelComponent component) const {
+    const unsigned bit = _component_bit(component);
+    if (_components.load() & bit) return;
+    switch (component) {
+        case ModelComponent::shape_blends: {
+            _SMPLX_ASSERT(_npz);
+            // Inflated straight into the (column-major) columns, keeping
+            // those of the shape space (see set_shape_space)
+            const size_t n_all = ModelConfig::n_shape_blends(),
+                         n_all_expr = ModelConfig::n_expression_blends(),
+                         n_expr = n_expression_blends(),
+                         n_body = n_shape_blends() - n_expr;
+            std::vector<int> col_map(n_all, -1);
+            for (size_t i = 0; i < n_body; ++i) col_map[i] = (int)i;
+            for (size_t i = 0; i < n_expr; ++i) {
+                col_map[n_all - n_all_expr + i] = (int)(n_body + i);
+            }
+            _npz->load_cols_into("shapedirs", {n_verts(), 3, n_all}, col_map,
+                                 static_cast<Scalar*>(
+                                     _blend_shapes_storage.get()),
+                                 1, 3 * n_verts());
+
+            // Joint shape blend shapes, for derivatives w.r.t. shape
+            joint_shape_blends.resize(3 * n_joints(), n_shape_blends());
+            for (size_t i = 0; i < n_shape_blends(); ++i) {
+                Eigen::Map<Points> joints_blend(
+                    joint_shape_blends.col(i).data(), n_joints(), 3);
+                joints_blend.noalias() =
+                    joint_reg * Eigen::Map<const Points>(
+                                    blend_shapes.col(i).data(), n_verts(), 3);
+            }
+            break;
+        }
+        case ModelComponent::pose_blends: {
+            _SMPLX_ASSERT(_npz);
+            _npz->load_into("posedirs", {n_verts(), 3, n_pose_blends()},
+                            static_cast<Scalar*>(
+                                _blend_shapes_storage.get()) +
+                                3 * n_verts() * n_shape_blends(),
+                            1, 3 * n_verts());
+            break;
+        }
+        case ModelComponent::hand_pca:
+            // Model has hand PCA (e.g. SMPLXpca), load hand PCA
+            if (n_hand_pca() && _npz && _npz->contains("hands_meanl") &&
+                _npz->contains("hands_meanr")) {
+                const cnpy::NpyArray hml_raw = _npz->load("hands_meanl");
+                const cnpy::NpyArray hmr_raw = _npz->load("hands_meanr");
+                const cnpy::NpyArray hcl_raw =
+                    _npz->load("hands_componentsl");
+                const cnpy::NpyArray hcr_raw =
+                    _npz->load("hands_componentsr");
+
+                assert_shape(hml_raw, {util::ANY_SHAPE});
+                assert_shape(hmr_raw, {hml_raw.shape[0]});
+
+                size_t n_hand_params = hml_raw.shape[0];
+                _SMPLX_ASSERT_EQ(n_hand_params, n_hand_pca_joints() * 3);
+
+                assert_shape(hcl_raw, {n_hand_params, n_hand_params});
+                assert_shape(hcr_raw, {n_hand_params, n_hand_params});
+
+                hand_mean_l =
+                    util::load_float_matrix(hml_raw, n_hand_params, 1);
+                hand_mean_r =
+                    util::load_float_matrix(hmr_raw, n_hand_params, 1);
+
+                hand_comps_l = util::load_float_matrix(hcl_raw, n_hand_params,
+                                                       n_hand_params)
+                                   .topRows(n_hand_pca())
+                                   .transpose();
+                hand_comps_r = util::load_float_matrix(hcr_raw, n_hand_params,
+                                                       n_hand_params)
+                                   .topRows(n_hand_pca())
+                                   .transpose();
+            }
+            break;
+        case ModelComponent::uv_map:
+            if (_uv_path.size()) _load_uv(_uv_path);
+            if (_n_uv_verts) {
+                // Map each UV vertex back to its mesh vertex; any not in a
+                // UV face maps to vertex 0, so it is never out of bounds
+                IndexVector uv_vert_ids = IndexVector::Zero(_n_uv_verts);
                 for (size_t i = 0; i < n_faces(); ++i) {
-                    _SMPLX_ASSERT(ifs);
                     for (size_t j = 0; j < 3; ++j) {
-                        ifs >> uv_faces(i, j);
-                        // Make indices 0-based
-                        --uv_faces(i, j);
-                        _SMPLX_ASSERT_LT(uv_faces(i, j), _n_uv_verts);
+                        uv_vert_ids[uv_faces(i, j)] = faces(i, j);
                     }
                 }
+                share(std::move(uv_vert_ids), _uv_to_vert_data, uv_to_vert);
+            }
+            break;
+        case ModelComponent::face_region:
+            require({ModelComponent::shape_blends,
+                     ModelComponent::pose_blends});
+            _compute_face_region();
+            break;
+    }
+    _components.fetch_or(bit, std::memory_order_release);
+}
+
+template <class ModelConfig>
+void Model<ModelConfig>::_load_npz(const std::string& path) {
+    std::unique_ptr<internal::NpzReader> npz(new internal::NpzReader(path));
+    _unlock_pages();
+
+    // Arrays are converted into the members as they are inflated, and
+    // inflated concurrently
+    verts.resize(n_verts(), 3);
+    Triangles new_faces(n_faces(), 3);
+    internal::NpzReader::run_concurrently({
+        // Load base template
+        [&]() {
+            npz->load_into("v_template", {n_verts(), 3}, verts.data(), 3, 1);
+        },
+        // Load triangle mesh
+        [&]() {
+            npz->load_into("f", {n_faces(), 3}, new_faces.data(), 3, 1);
+        },
+        // Load joint regressor and LBS weights, keeping the nonzeros
+        [&]() {
+            npz->load_sparse("J_regressor", {n_joints(), n_verts()},
+                             joint_reg);
+        },
+        [&]() {
+            npz->load_sparse("weights", {n_verts(), n_joints()}, weights);
+        },
+    });
+    verts_load.resize(0, 3);
+    share(std::move(new_faces), _faces_data, faces);
+
+    // The rest is loaded on first use (see _load_component), blend shapes
+    // in the shape space only
+    _n_expression_blends =
+        std::min(_max_expression, ModelConfig::n_expression_blends());
+    _n_shape_blends =
+        std::min(_max_body_shape, ModelConfig::n_shape_blends() -
+                                      ModelConfig::n_expression_blends()) +
+        _n_expression_blends;
+    _blend_shapes_storage = _new_blend_shapes(n_blend_shapes());
+    _set_blend_shapes(static_cast<Scalar*>(_blend_shapes_storage.get()));
+    _image_owner.reset();
+    joint_shape_blends.resize(0, 0);
+    hand_mean_l.resize(0);
+    hand_mean_r.resize(0);
+    hand_comps_l.resize(0, 0);
+    hand_comps_r.resize(0, 0);
+    _npz = std::move(npz);
+    _components = 0;
+    _n_uv_verts = 0;
+}
+
+template <class ModelConfig>
+void Model<ModelConfig>::_load_binary(const internal::BinaryImage& image) {
+    namespace bin = internal::smplxbin;
+    auto fail = [](const std::string& msg) {
+        throw std::invalid_argument("Invalid .smplxbin: " + msg);
+    };
+    auto corrupt = [](const std::string& msg) {
+        throw std::runtime_error("Corrupt .smplxbin: " + msg);
+    };
+    if (image.size < sizeof(bin::Header)) corrupt("truncated header");
+    bin::Header header;
+    std::memcpy(&header, image.data, sizeof(header));
+    if (std::memcmp(header.magic, bin::MAGIC, sizeof(bin::MAGIC)) ||
+        header.version != bin::VERSION) {
+        fail("unsupported version");
+    }
+    if (std::strncmp(header.model_name, ModelConfig::model_name,
+                     sizeof(header.model_name)) ||
+        header.n_verts != n_verts() || header.n_faces != n_faces() ||
+        header.n_joints != n_joints() ||
+        header.n_pose_blends != n_pose_blends()) {
+        fail(std::string("saved from model '") +
+             std::string(header.model_name,
+                         strnlen(header.model_name,
+                                 sizeof(header.model_name))) +
+             "', expected '" + ModelConfig::model_name + "'");
+    }
+    // May have been saved with a truncated shape space
+    const size_t n_shape = header.n_shape_blends,
+                 n_expr = header.n_expression_blends;
+    if (n_expr > n_shape || n_expr > ModelConfig::n_expression_blends() ||
+        n_shape - n_expr > ModelConfig::n_shape_blends() -
+                               ModelConfig::n_expression_blends()) {
+        fail("bad shape space");
+    }
+
+    // Every section is validated before anything is replaced, so a
+    // rejected image leaves the model as it was.
+    // Start of section, checking its size in bytes; nullptr if absent and
+    // optional
+    auto section = [&](bin::Section id, size_t size,
+                       bool optional = false) -> const char* {
+        const bin::SectionEntry& entry = header.sections[id];
+        if (optional && entry.size == 0) return nullptr;
+        if (entry.size != size || entry.offset % sizeof(Scalar) ||
+            entry.offset > image.size || size > image.size - entry.offset) {
+            corrupt("bad section " + std::to_string(id));
+        }
+        return image.data + entry.offset;
+    };
+    auto floats = [&](bin::Section id, size_t n) {
+        return reinterpret_cast<const Scalar*>(section(id, n * sizeof(Scalar)));
+    };
+    auto indices = [&](bin::Section id, size_t n) {
+        return reinterpret_cast<const Index*>(section(id, n * sizeof(Index)));
+    };
+    // CSR matrix of outer_id and the next two sections, with outer starting
+    // at 0 and nondecreasing and inner indices < cols
+    auto csr = [&](bin::Section outer_id, size_t rows, size_t cols) {
+        const int* outer = reinterpret_cast<const int*>(
+            section(outer_id, (rows + 1) * sizeof(int)));
+        bool valid = outer[0] == 0;
+        for (size_t i = 0; valid && i < rows; ++i) {
+            valid = outer[i] <= outer[i + 1];
+        }
+        if (!valid) corrupt("bad sparse section " + std::to_string(outer_id));
+        const size_t nnz = outer[rows];
+        const int* inner = reinterpret_cast<const int*>(
+            section(bin::Section(outer_id + 1), nnz * sizeof(int)));
+        for (size_t k = 0; k < nnz; ++k) {
+            if (inner[k] < 0 || (size_t)inner[k] >= cols) {
+                corrupt("bad sparse section " +
+                        std::to_string(outer_id + 1));
             }
         }
+        return Eigen::Map<const SparseMatrix>(
+            rows, cols, nnz, outer, inner,
+            floats(bin::Section(outer_id + 2), nnz));
+    };
+    const Scalar* blend_shapes_data = floats(
+        bin::blend_shapes, 3 * n_verts() * (n_shape + n_pose_blends()));
+    const Scalar* verts_data = floats(bin::verts, 3 * n_verts());
+    const Index* faces_data = indices(bin::faces, 3 * n_faces());
+    for (size_t i = 0; i < 3 * n_faces(); ++i) {
+        if (faces_data[i] >= n_verts()) corrupt("bad faces");
+    }
+    const Eigen::Map<const SparseMatrix> new_joint_reg =
+        csr(bin::joint_reg_outer, n_joints(), n_verts());
+    const Eigen::Map<const SparseMatrix> new_weights =
+        csr(bin::weights_outer, n_verts(), n_joints());
+    const Scalar* joint_shape_blends_data =
+        floats(bin::joint_shape_blends, 3 * n_joints() * n_shape);
+
+    // Hand PCA, used if the ModelConfig has it
+    const size_t n_hand_params =
+        n_hand_pca() ? (size_t)header.n_hand_params : 0;
+    const Scalar* hand_data[4] = {nullptr, nullptr, nullptr, nullptr};
+    if (n_hand_params) {
+        if (n_hand_params != n_hand_pca_joints() * 3 ||
+            header.n_hand_pca != n_hand_pca()) {
+            corrupt("bad hand PCA size");
+        }
+        hand_data[0] = floats(bin::hand_mean_l, n_hand_params);
+        hand_data[1] = floats(bin::hand_mean_r, n_hand_params);
+        hand_data[2] = floats(bin::hand_comps_l, n_hand_params * n_hand_pca());
+        hand_data[3] = floats(bin::hand_comps_r, n_hand_params * n_hand_pca());
+    }
+
+    const size_t n_uv_verts = header.n_uv_verts;
+    const Scalar* uv_data = nullptr;
+    const Index* uv_faces_data = nullptr;
+    if (n_uv_verts) {
+        uv_faces_data = indices(bin::uv_faces, 3 * n_faces());
+        for (size_t i = 0; i < 3 * n_faces(); ++i) {
+            if (uv_faces_data[i] >= n_uv_verts) corrupt("bad UV faces");
+        }
+        uv_data = floats(bin::uv, 2 * n_uv_verts);
+    }
+
+    _unlock_pages();
+    verts.noalias() = Eigen::Map<const Points>(verts_data, n_verts(), 3);
+    verts_load.resize(0, 3);
+    share(Triangles(Eigen::Map<const Triangles>(faces_data, n_faces(), 3)),
+          _faces_data, faces);
+    joint_reg = new_joint_reg;
+    weights = new_weights;
+    joint_shape_blends.noalias() = Eigen::Map<const MatrixColMajor>(
+        joint_shape_blends_data, 3 * n_joints(), n_shape);
+    if (n_hand_params) {
+        hand_mean_l = Eigen::Map<const Vector>(hand_data[0], n_hand_params);
+        hand_mean_r = Eigen::Map<const Vector>(hand_data[1], n_hand_params);
+        hand_comps_l = Eigen::Map<const Matrix>(hand_data[2], n_hand_params,
+                                                n_hand_pca());
+        hand_comps_r = Eigen::Map<const Matrix>(hand_data[3], n_hand_params,
+                                                n_hand_pca());
+    } else {
+        // Not left over from the previous model
+        hand_mean_l.resize(0);
+        hand_mean_r.resize(0);
+        hand_comps_l.resize(0, 0);
+        hand_comps_r.resize(0, 0);
+    }
+    _n_uv_verts = n_uv_verts;
+    if (n_uv_verts) {
+        share(Points2D(Eigen::Map<const Points2D>(uv_data, n_uv_verts, 2)),
+              _uv_data, uv);
+        share(Triangles(Eigen::Map<const Triangles>(uv_faces_data, n_faces(),
+                                                    3)),
+              _uv_faces_data, uv_faces);
+    }
+
+    gender = static_cast<Gender>(header.gender);
+    _n_shape_blends = n_shape;
+    _n_expression_blends = n_expr;
+    _set_blend_shapes(blend_shapes_data);
+    _blend_shapes_storage.reset();
+    _image_owner = image.owner;
+    // Everything is in the image, which is paged in on demand
+    _npz.reset();
+    _components = _component_bit(ModelComponent::shape_blends) |
+                  _component_bit(ModelComponent::pose_blends) |
+                  _component_bit(ModelComponent::hand_pca);
+    // Copies the kept blend shapes if the shape space is smaller
+    _truncate_shape_space();
+}
+
+template <class ModelConfig>
+void Model<ModelConfig>::_load_uv(const std::string& uv_path) const {
+    Points2D new_uv;
+    Triangles new_uv_faces;
+    internal::load_uv_map(uv_path, n_faces(), new_uv, new_uv_faces);
+    if ((size_t)new_uv.rows() != _n_uv_verts) {
+        throw std::runtime_error("UV map '" + uv_path + "' has " +
+                                 std::to_string(new_uv.rows()) +
+                                 " vertices, expected " +
+                                 std::to_string(_n_uv_verts));
+    }
+    share(std::move(new_uv), _uv_data, uv);
+    share(std::move(new_uv_faces), _uv_faces_data, uv_faces);
+}
+
+template <class ModelConfig>
+std::shared_ptr<void> Model<ModelConfig>::_new_blend_shapes(
+    size_t n_cols) const {
+    return internal::allocate_pages(3 * n_verts() * n_cols * sizeof(Scalar),
+                                    _huge_pages);
+}
+
+template <class ModelConfig>
+void Model<ModelConfig>::_set_blend_shapes(const Scalar* data) {
+    // Eigen's way to re-seat a Map
+    new (&blend_shapes)
+        Eigen::Map<const BlendShapes>(data, 3 * n_verts(), n_blend_shapes());
+}
+
+template <class ModelConfig>
+uint64_t Model<ModelConfig>::_binary_layout(
+    internal::smplxbin::Header& header,
+    const void* data[internal::smplxbin::n_sections]) const {
+    namespace bin = internal::smplxbin;
+    require({ModelComponent::shape_blends, ModelComponent::pose_blends,
+             ModelComponent::hand_pca, ModelComponent::uv_map});
+    std::memset(&header, 0, sizeof(header));
+    std::fill(data, data + bin::n_sections, nullptr);
+    std::memcpy(header.magic, bin::MAGIC, sizeof(bin::MAGIC));
+    header.version = bin::VERSION;
+    header.gender = static_cast<uint32_t>(gender);
+    std::strncpy(header.model_name, ModelConfig::model_name,
+                 sizeof(header.model_name) - 1);
+    header.n_verts = n_verts();
+    header.n_faces = n_faces();
+    header.n_joints = n_joints();
+    header.n_shape_blends = n_shape_blends();
+    header.n_expression_blends = n_expression_blends();
+    header.n_pose_blends = n_pose_blends();
+    header.n_hand_params = hand_mean_l.size();
+    header.n_hand_pca = header.n_hand_params ? n_hand_pca() : 0;
+    header.n_uv_verts = _n_uv_verts;
+
+    auto set = [&](bin::Section id, const void* ptr, size_t size) {
+        data[id] = ptr;
+        header.sections[id].size = size;
+    };
+    auto set_csr = [&](bin::Section outer_id, const SparseMatrix& m) {
+        _SMPLX_ASSERT(m.isCompressed());
+        set(outer_id, m.outerIndexPtr(), (m.outerSize() + 1) * sizeof(int));
+        set(bin::Section(outer_id + 1), m.innerIndexPtr(),
+            m.nonZeros() * sizeof(int));
+        set(bin::Section(outer_id + 2), m.valuePtr(),
+            m.nonZeros() * sizeof(Scalar));
+    };
+    const Points& loaded_verts = verts_load.rows() ? verts_load : verts;
+    set(bin::verts, loaded_verts.data(),
+        loaded_verts.size() * sizeof(Scalar));
+    set(bin::faces, faces.data(), faces.size() * sizeof(Index));
+    set_csr(bin::joint_reg_outer, joint_reg);
+    set_csr(bin::weights_outer, weights);
+    set(bin::blend_shapes, blend_shapes.data(),
+        blend_shapes.size() * sizeof(Scalar));
+    set(bin::joint_shape_blends, joint_shape_blends.data(),
+        joint_shape_blends.size() * sizeof(Scalar));
+    if (header.n_hand_params) {
+        set(bin::hand_mean_l, hand_mean_l.data(),
+            hand_mean_l.size() * sizeof(Scalar));
+        set(bin::hand_mean_r, hand_mean_r.data(),
+            hand_mean_r.size() * sizeof(Scalar));
+        set(bin::hand_comps_l, hand_comps_l.data(),
+            hand_comps_l.size() * sizeof(Scalar));
+        set(bin::hand_comps_r, hand_comps_r.data(),
+            hand_comps_r.size() * sizeof(Scalar));
+    }
+    if (_n_uv_verts) {
+        set(bin::uv, uv.data(), uv.size() * sizeof(Scalar));
+        set(bin::uv_faces, uv_faces.data(), uv_faces.size() * sizeof(Index));
+    }
+
+    uint64_t offset = bin::align(sizeof(header));
+    for (size_t i = 0; i < bin::n_sections; ++i) {
+        if (!header.sections[i].size) continue;
+        header.sections[i].offset = offset;
+        offset = bin::align(offset + header.sections[i].size);
+    }
+
+    return offset;
+}
+
+template <class ModelConfig>
+void Model<ModelConfig>::save_binary(const std::string& path) const {
+    namespace bin = internal::smplxbin;
+    bin::Header header;
+    const void* data[bin::n_sections];
+    _binary_layout(header, data);
+    std::ofstream ofs(path, std::ios::binary);
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    const std::vector<char> padding(bin::ALIGN);
+    uint64_t pos = sizeof(header);
+    for (size_t i = 0; i < bin::n_sections; ++i) {
+        const bin::SectionEntry& entry = header.sections[i];
+        if (!entry.size) continue;
+        ofs.write(padding.data(), entry.offset - pos);
+        ofs.write(static_cast<const char*>(data[i]), entry.size);
+        pos = entry.offset + entry.size;
+    }
+    if (!ofs) throw std::runtime_error("Cannot write '" + path + "'");
+}
+
+template <class ModelConfig>
+void Model<ModelConfig>::_compute_face_region() const {
+    const size_t n_expr = n_expression_blends(),
+                 n_face_joints = ModelConfig::n_face_joints(),
+                 face_joint = ModelConfig::face_joint_begin();
+    const size_t expr_col = n_shape_blends() - n_expr,
+                 face_pose_col = n_shape_blends() + 9 * (face_joint - 1);
+    face_verts.clear();
+    face_blend_shapes.resize(0, 0);
+    if (n_expr == 0 && n_face_joints == 0) return;
+
+    auto rows_used = [&](size_t v, size_t col, size_t n_cols) {
+        return n_cols && !blend_shapes.block(3 * v, col, 3, n_cols).isZero(0);
+    };
+    // Expression moves verts_shaped and, through the joint regressor, the
+    // joints and every joint transform below them; face joint rotations move
+    // their transforms and the face pose blend shapes
+    std::vector<char> moved(n_verts()), joint_moved(n_joints());
+    for (size_t v = 0; v < n_verts(); ++v) {
+        moved[v] = rows_used(v, expr_col, n_expr);
+    }
+    for (size_t j = 0; j < n_joints(); ++j) {
+        for (SparseMatrix::InnerIterator it(joint_reg, j); it; ++it) {
+            if (moved[it.col()]) joint_moved[j] = true;
+        }
+    }
+    for (size_t j = face_joint; j < face_joint + n_face_joints; ++j) {
+        joint_moved[j] = true;
+    }
+    for (size_t j = 1; j < n_joints(); ++j) {
+        if (joint_moved[ModelConfig::parent[j]]) joint_moved[j] = true;
+    }
+    for (size_t v = 0; v < n_verts(); ++v) {
+        if (rows_used(v, face_pose_col, 9 * n_face_joints)) moved[v] = true;
+        for (SparseMatrix::InnerIterator it(weights, v); it; ++it) {
+            if (joint_moved[it.col()]) moved[v] = true;
+        }
+        if (moved[v]) face_verts.push_back(v);
+    }
+    if (face_verts.size() * 2 > n_verts()) {
+        // Not worth a separate path
+        face_verts.clear();
+        return;
+    }
+
+    face_blend_shapes.resize(3 * face_verts.size(),
+                             n_expr + 9 * n_face_joints);
+    for (size_t i = 0; i < face_verts.size(); ++i) {
+        const size_t row = 3 * face_verts[i];
+        face_blend_shapes.block(3 * i, 0, 3, n_expr) =
+            blend_shapes.block(row, expr_col, 3, n_expr);
+        if (!n_face_joints) continue;
+        face_blend_shapes.block(3 * i, n_expr, 3, 9 * n_face_joints) =
+            blend_shapes.block(row, face_pose_col, 3, 9 * n_face_joints);
     }
-#ifdef SMPLX_CUDA_ENABLED
-    _cuda_load();
-#endif
 }
 
 template <class ModelConfig>
 void Model<ModelConfig>::set_deformations(const Eigen::Ref<const Points>& d) {
+    if (verts_load.rows() == 0) verts_load = verts;
     verts.noalias() = verts_load + d;
-#ifdef SMPLX_CUDA_ENABLED
-    _cuda_copy_template();
-#endif
+    _template_changed();
 }
 
 template <class ModelConfig>
 void Model<ModelConfig>::set_template(const Eigen::Ref<const Points>& t) {
+    if (verts_load.rows() == 0) verts_load = verts;
     verts.noalias() = t;
-#ifdef SMPLX_CUDA_ENABLED
-    _cuda_copy_template();
-#endif
+    _template_changed();
+}
+
+template <class ModelConfig>
+MemoryUsage Model<ModelConfig>::memory_usage() const {
+    using util::dense_bytes;
+    using util::sparse_bytes;
+    MemoryUsage usage;
+    auto& parts = usage.parts;
+    parts["verts"] = dense_bytes(verts);
+    parts["verts_load"] = dense_bytes(verts_load);
+    parts["joints"] = dense_bytes(joints);
+    parts["faces"] = dense_bytes(faces);
+    parts["vert_faces"] = sparse_bytes(vert_faces);
+    parts["joint_reg"] = sparse_bytes(joint_reg);
+    parts["weights"] = sparse_bytes(weights);
+
+    // Columns of components not loaded yet take no memory, unless mapped
+    size_t blend_cols = n_blend_shapes();
+    if (!_image_owner) {
+        blend_cols =
+            (is_loaded(ModelComponent::shape_blends) ? n_shape_blends() : 0) +
+            (is_loaded(ModelComponent::pose_blends) ? n_pose_blends() : 0);
+    }
+    parts["blend_shapes"] = 3 * n_verts() * blend_cols * sizeof(Scalar);
+
+    // Members of components, which may be loading on other threads
+    auto lock = [this](ModelComponent component) {
+        return std::unique_lock<std::mutex>(
+            _component_mtx[static_cast<size_t>(component)]);
+    };
+    {
+        auto guard = lock(ModelComponent::shape_blends);
+        parts["joint_shape_blends"] = dense_bytes(joint_shape_blends);
+    }
+    {
+        auto guard = lock(ModelComponent::hand_pca);
+        parts["hand_pca"] =
+            dense_bytes(hand_comps_l) + dense_bytes(hand_comps_r) +
+            dense_bytes(hand_mean_l) + dense_bytes(hand_mean_r);
+    }
+    {
+        auto guard = lock(ModelComponent::uv_map);
+        parts["uv_map"] = dense_bytes(uv) + dense_bytes(uv_faces) +
+                          dense_bytes(uv_to_vert);
+    }
+    {
+        auto guard = lock(ModelComponent::face_region);
+        parts["face_region"] = face_verts.size() * sizeof(Index) +
+                               dense_bytes(face_blend_shapes);
+    }
+
+    size_t lod_bytes = 0;
+    for (const auto& lod : _lods) {
+        lod_bytes += lod->vert_ids.size() * sizeof(Index) +
+                     dense_bytes(lod->faces) + sparse_bytes(lod->vert_faces) +
+                     dense_bytes(lod->verts) + dense_bytes(lod->blend_shapes) +
+                     sparse_bytes(lod->weights);
+    }
+    parts["lods"] = lod_bytes;
+    return usage;
+}
+
+template <class ModelConfig>
+void Model<ModelConfig>::set_huge_pages(HugePages mode) {
+    _huge_pages = mode;
+    // Nothing to move if mapped
+    if (!_blend_shapes_storage) return;
+    // The old storage is freed below; pin the new one instead
+    const bool locked = _unlock_pages();
+    auto storage = _new_blend_shapes(n_blend_shapes());
+    Eigen::Map<BlendShapes> data(static_cast<Scalar*>(storage.get()),
+                                 3 * n_verts(), n_blend_shapes());
+    if (is_loaded(ModelComponent::shape_blends)) {
+        data.leftCols(n_shape_blends()) =
+            blend_shapes.leftCols(n_shape_blends());
+    }
+    if (is_loaded(ModelComponent::pose_blends)) {
+        data.rightCols(n_pose_blends()) =
+            blend_shapes.rightCols(n_pose_blends());
+    }
+    _blend_shapes_storage = std::move(storage);
+    _set_blend_shapes(static_cast<Scalar*>(_blend_shapes_storage.get()));
+    if (locked) _prefault_pages(true);
+}
+
+template <class ModelConfig>
+void Model<ModelConfig>::warmup(bool lock_memory) const {
+    preload();
+    _prefault_pages(lock_memory);
+
+    for (Backend backend :
+         {Backend::cpu_simd, Backend::cpu_parallel, Backend::cuda}) {
+        if (!util::backend_available(backend)) continue;
+        Body<ModelConfig> body(*this);
+        body.set_backend(backend);
+        body.update();
+        body.verts();
+    }
+}
+
+template <class ModelConfig>
+void Model<ModelConfig>::_prefault_pages(bool lock) const {
+    bool locked = true;
+    auto prefault = [&](const void* data, size_t bytes) {
+        if (!internal::prefault_pages(data, bytes, lock)) {
+            locked = false;
+        } else if (lock && bytes) {
+            std::lock_guard<std::mutex> guard(_locked_pages_mtx);
+            _locked_pages.emplace_back(data, bytes);
+        }
+    };
+    auto prefault_sparse = [&](const SparseMatrix& m) {
+        prefault(m.valuePtr(), m.nonZeros() * sizeof(Scalar));
+        prefault(m.innerIndexPtr(), m.nonZeros() * sizeof(int));
+        prefault(m.outerIndexPtr(), (m.outerSize() + 1) * sizeof(int));
+    };
+    prefault(blend_shapes.data(), util::dense_bytes(blend_shapes));
+    prefault(joint_shape_blends.data(), util::dense_bytes(joint_shape_blends));
+    prefault(verts.data(), util::dense_bytes(verts));
+    prefault_sparse(weights);
+    prefault_sparse(joint_reg);
+    if (!locked) {
+        std::cerr << "WARNING: could not lock the " << name()
+                  << " model data in memory; raise the memlock limit "
+                     "(ulimit -l)\n";
+    }
+}
+
+template <class ModelConfig>
+bool Model<ModelConfig>::_unlock_pages() {
+    std::lock_guard<std::mutex> lock(_locked_pages_mtx);
+    for (const auto& range : _locked_pages) {
+        internal::unlock_pages(range.first, range.second);
+    }
+    const bool any = !_locked_pages.empty();
+    _locked_pages.clear();
+    return any;
+}
+
+template <class ModelConfig>
+size_t Model<ModelConfig>::add_lod(size_t target_verts) {
+    std::vector<Index> vert_ids;
+    Triangles lod_faces;
+    util::decimate_mesh(verts, faces, target_verts, vert_ids, lod_faces);
+    return add_lod(vert_ids, lod_faces);
+}
+
+template <class ModelConfig>
+size_t Model<ModelConfig>::add_lod(const std::vector<Index>& vert_ids,
+                                   const Triangles& faces) {
+    for (Index v : vert_ids) _SMPLX_ASSERT_LT(v, n_verts());
+    if (faces.size()) _SMPLX_ASSERT_LT(faces.maxCoeff(), vert_ids.size());
+    std::shared_ptr<LOD> lod = std::make_shared<LOD>();
+    lod->vert_ids = vert_ids;
+    lod->faces = faces;
+    lod->vert_faces = vert_face_adjacency(faces, vert_ids.size());
+    _gather_lod(*lod);
+    _lods.push_back(std::move(lod));
+    return _lods.size();
+}
+
+template <class ModelConfig>
+void Model<ModelConfig>::clear_lods() {
+    _lods.clear();
+}
+
+template <class ModelConfig>
+void Model<ModelConfig>::_gather_lod(LOD& lod) const {
+    require({ModelComponent::shape_blends, ModelComponent::pose_blends});
+    const size_t n = lod.n_verts();
+    lod.verts.resize(n, 3);
+    lod.blend_shapes.resize(3 * n, n_blend_shapes());
+    std::vector<Eigen::Triplet<Scalar, int>> w_triplets;
+    for (size_t i = 0; i < n; ++i) {
+        const Index v = lod.vert_ids[i];
+        lod.verts.row(i).noalias() = verts.row(v);
+        lod.blend_shapes.template middleRows<3>(3 * i).noalias() =
+            blend_shapes.template middleRows<3>(3 * v);
+        for (SparseMatrix::InnerIterator it(weights, v); it; ++it) {
+            w_triplets.emplace_back(i, it.col(), it.value());
+        }
+    }
+    lod.weights.resize(n, n_joints());
+    lod.weights.setFromTriplets(w_triplets.begin(), w_triplets.end());
+    lod.weights.makeCompressed();
+    lod.joints = joint_reg * verts;
+}
+
+template <class ModelConfig>
+void Model<ModelConfig>::set_backend(Backend backend) {
+    if (!util::backend_available(backend)) {
+        throw std::invalid_argument(std::string("Backend ") +
+                                    util::backend_to_str(backend) +
+                                    " is not available in this build");
+    }
+    _backend = backend;
+}
+
+template <class ModelConfig>
+internal::ModelBackend<ModelConfig>& Model<ModelConfig>::backend_data(
+    Backend backend) const {
+    _SMPLX_ASSERT(backend != Backend::automatic);
+    std::lock_guard<std::mutex> lock(_backend_mtx);
+    auto& data = _backend_data[static_cast<size_t>(backend)];
+    if (!data) {
+        data = internal::create_model_backend(*this, backend);
+        if (!data) {
+            throw std::invalid_argument(std::string("Backend ") +
+                                        util::backend_to_str(backend) +
+                                        " is not available in this build");
+        }
+    }
+    return *data;
+}
+
+template <class ModelConfig>
+void Model<ModelConfig>::_template_changed() {
+    if (!_lods.empty()) {
+        const Points template_joints = joint_reg * verts;
+        for (auto& lod : _lods) {
+            for (size_t i = 0; i < lod->n_verts(); ++i) {
+                lod->verts.row(i).noalias() = verts.row(lod->vert_ids[i]);
+            }
+            lod->joints = template_joints;
+        }
+    }
+    std::lock_guard<std::mutex> lock(_backend_mtx);
+    for (auto& data : _backend_data) {
+        if (data) data->template_changed();
+    }
 }
 
 // Instantiations
@@ -0,0 +1,369 @@
+#include "smplx/internal/model_bin.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace smplx {
+namespace internal {
+
+namespace {
+// Size (and alignment) of the huge pages requested
+const size_t HUGE_PAGE_SIZE = 2 << 20;
+
+inline size_t round_up(size_t n, size_t align) {
+    return (n + align - 1) / align * align;
+}
+}  // namespace
+
+BinaryImage map_file(const std::string& path) {
+    BinaryImage image;
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                              nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Cannot open '" + path + "'");
+    }
+    LARGE_INTEGER size;
+    HANDLE mapping = nullptr;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+        mapping =
+            CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    }
+    CloseHandle(file);
+    void* addr =
+        mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (mapping) CloseHandle(mapping);
+    if (!addr) throw std::runtime_error("Cannot map '" + path + "'");
+    image.size = (size_t)size.QuadPart;
+    image.owner =
+        std::shared_ptr<const void>(addr, [](const void* p) {
+            UnmapViewOfFile(p);
+        });
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Cannot open '" + path + "'");
+    struct stat st;
+    void* addr = MAP_FAILED;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+        addr = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        throw std::runtime_error("Cannot map '" + path + "'");
+    }
+    image.size = (size_t)st.st_size;
+    const size_t size = image.size;
+    image.owner = std::shared_ptr<const void>(
+        addr, [size](const void* p) { ::munmap(const_cast<void*>(p), size); });
+#endif
+    image.data = static_cast<const char*>(image.owner.get());
+    return image;
+}
+
+#ifdef _WIN32
+std::shared_ptr<void> allocate_pages(size_t size, HugePages mode) {
+    // Large pages need the lock pages privilege; use normal pages
+    if (!size) return nullptr;
+    void* addr = VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE,
+                              PAGE_READWRITE);
+    if (!addr) throw std::bad_alloc();
+    return std::shared_ptr<void>(
+        addr, [](void* p) { VirtualFree(p, 0, MEM_RELEASE); });
+}
+
+bool prefault_pages(const void* data, size_t size, bool lock) {
+    if (!size) return true;
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    const volatile char* bytes = static_cast<const volatile char*>(data);
+    for (size_t i = 0; i < size; i += info.dwPageSize) (void)bytes[i];
+    (void)bytes[size - 1];
+    return !lock || VirtualLock(const_cast<void*>(data), size);
+}
+
+void unlock_pages(const void* data, size_t size) {
+    if (size) VirtualUnlock(const_cast<void*>(data), size);
+}
+#else
+std::shared_ptr<void> allocate_pages(size_t size, HugePages mode) {
+    if (!size) return nullptr;
+    const int prot = PROT_READ | PROT_WRITE,
+              flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    auto owner = [](void* addr, size_t mapped) {
+        return std::shared_ptr<void>(
+            addr, [mapped](void* p) { ::munmap(p, mapped); });
+    };
+    if (mode == HugePages::off) {
+        void* addr = ::mmap(nullptr, size, prot, flags, -1, 0);
+        if (addr == MAP_FAILED) throw std::bad_alloc();
+        return owner(addr, size);
+    }
+    const size_t huge_size = round_up(size, HUGE_PAGE_SIZE);
+#ifdef MAP_HUGETLB
+    if (mode == HugePages::reserved) {
+        // Fails if the reserved pool is too small
+        void* addr =
+            ::mmap(nullptr, huge_size, prot, flags | MAP_HUGETLB, -1, 0);
+        if (addr != MAP_FAILED) return owner(addr, huge_size);
+    }
+#endif
+    // Align to a huge page, so all pages may be huge
+    const size_t mapped = huge_size + HUGE_PAGE_SIZE;
+    void* addr = ::mmap(nullptr, mapped, prot, flags, -1, 0);
+    if (addr == MAP_FAILED) throw std::bad_alloc();
+    char* begin = static_cast<char*>(addr);
+    char* aligned = reinterpret_cast<char*>(
+        round_up(reinterpret_cast<uintptr_t>(begin), HUGE_PAGE_SIZE));
+    if (aligned > begin) ::munmap(begin, aligned - begin);
+    char* end = aligned + huge_size;
+    if (begin + mapped > end) ::munmap(end, begin + mapped - end);
+#ifdef MADV_HUGEPAGE
+    // Pages are allocated on first write, then as huge pages
+    ::madvise(aligned, huge_size, MADV_HUGEPAGE);
+#endif
+    return owner(aligned, huge_size);
+}
+
+bool prefault_pages(const void* data, size_t size, bool lock) {
+    if (!size) return true;
+    const size_t page = (size_t)::sysconf(_SC_PAGESIZE);
+    char* first = reinterpret_cast<char*>(
+        reinterpret_cast<uintptr_t>(data) / page * page);
+    const size_t span = static_cast<const char*>(data) + size - first;
+    // Start reading ahead any file pages
+    ::madvise(first, span, MADV_WILLNEED);
+    // mlock faults the pages in itself
+    if (lock && ::mlock(first, span) == 0) return true;
+    const volatile char* bytes = first;
+    for (size_t i = 0; i < span; i += page) (void)bytes[i];
+    return !lock;
+}
+
+void unlock_pages(const void* data, size_t size) {
+    if (size) ::munlock(data, size);
+}
+#endif
+
+namespace {
+const char SHARED_MAGIC[8] = {'S', 'M', 'P', 'L', 'X', 'S', 'H', 'M'};
+// Bytes before the image; a multiple of any page size, so the image can be
+// mapped separately (read-only)
+const size_t SHARED_CONTROL_SIZE = 65536;
+
+// Start of a shared segment
+struct SharedControl {
+    char magic[8];
+    // Set once the image is complete
+    std::atomic<uint32_t> ready;
+    std::atomic<uint32_t> n_attached;
+    uint64_t generation;
+    uint64_t size;
+};
+
+#ifndef _WIN32
+std::runtime_error shared_error(const std::string& what,
+                                const std::string& name) {
+    return std::runtime_error(what + " shared memory '" + name +
+                              "': " + std::strerror(errno));
+}
+
+// Map the control block of open segment fd and set segment_size to the
+// segment's size; nullptr if not a segment, with pending set if it may be
+// one whose publisher has not written the control block yet
+SharedControl* map_control(int fd, bool writable, uint64_t& segment_size,
+                           bool& pending) {
+    struct stat st;
+    pending = false;
+    if (::fstat(fd, &st) != 0) return nullptr;
+    segment_size = (uint64_t)st.st_size;
+    if (segment_size < SHARED_CONTROL_SIZE) {
+        // Created but not yet sized by publish_shared_image
+        pending = segment_size == 0;
+        return nullptr;
+    }
+    void* addr = ::mmap(nullptr, SHARED_CONTROL_SIZE,
+                        writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                        MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) return nullptr;
+    SharedControl* control = static_cast<SharedControl*>(addr);
+    if (std::memcmp(control->magic, SHARED_MAGIC, sizeof(SHARED_MAGIC))) {
+        const char zeros[sizeof(SHARED_MAGIC)] = {};
+        pending = !std::memcmp(control->magic, zeros, sizeof(zeros));
+        ::munmap(addr, SHARED_CONTROL_SIZE);
+        return nullptr;
+    }
+    return control;
+}
+
+// Error for a segment map_control rejected
+std::runtime_error not_a_model(const std::string& name, bool pending) {
+    return std::runtime_error(
+        "Shared memory '" + name + "' " +
+        (pending ? "is not yet published" : "does not hold a model"));
+}
+#endif
+}  // namespace
+
+#ifdef _WIN32
+void publish_shared_image(const std::string& name, uint64_t size,
+                          const std::function<void(char*)>& write) {
+    throw std::runtime_error("Shared memory models require POSIX");
+}
+BinaryImage attach_shared_image(const std::string& name, bool* counted) {
+    throw std::runtime_error("Shared memory models require POSIX");
+}
+bool unlink_shared_image(const std::string& name) { return false; }
+SharedImageInfo shared_image_info(const std::string& name) {
+    throw std::runtime_error("Shared memory models require POSIX");
+}
+#else
+void publish_shared_image(const std::string& name, uint64_t size,
+                          const std::function<void(char*)>& write) {
+    static_assert(std::atomic<uint32_t>::is_always_lock_free,
+                  "Shared counters must be lock-free");
+    uint64_t generation = 1;
+    int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd >= 0) {
+        uint64_t old_size;
+        bool pending;
+        SharedControl* old = map_control(fd, false, old_size, pending);
+        ::close(fd);
+        if (old) {
+            generation = old->generation + 1;
+            ::munmap(old, SHARED_CONTROL_SIZE);
+        }
+        // Attached processes keep the unlinked segment until they unmap it
+        ::shm_unlink(name.c_str());
+    }
+    fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) throw shared_error("Cannot create", name);
+    const size_t total = SHARED_CONTROL_SIZE + size;
+    void* addr = MAP_FAILED;
+    if (::ftruncate(fd, total) == 0) {
+        addr = ::mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                      0);
+    }
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        const std::runtime_error error = shared_error("Cannot map", name);
+        ::shm_unlink(name.c_str());
+        throw error;
+    }
+    SharedControl* control = new (addr) SharedControl;
+    control->ready.store(0);
+    control->n_attached.store(0);
+    control->generation = generation;
+    control->size = size;
+    std::memcpy(control->magic, SHARED_MAGIC, sizeof(SHARED_MAGIC));
+    write(static_cast<char*>(addr) + SHARED_CONTROL_SIZE);
+    control->ready.store(1, std::memory_order_release);
+    ::munmap(addr, total);
+}
+
+BinaryImage attach_shared_image(const std::string& name, bool* counted) {
+    // Writable only for the counter; other users than the publisher may
+    // only read the segment
+    int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+    const bool writable = fd >= 0;
+    if (!writable) fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) throw shared_error("Cannot open", name);
+    uint64_t segment_size;
+    bool pending;
+    SharedControl* control = map_control(fd, writable, segment_size, pending);
+    if (!control) {
+        ::close(fd);
+        throw not_a_model(name, pending);
+    }
+    if (!control->ready.load(std::memory_order_acquire)) {
+        ::munmap(control, SHARED_CONTROL_SIZE);
+        ::close(fd);
+        throw not_a_model(name, true);
+    }
+    const size_t size = control->size;
+    if (size > segment_size - SHARED_CONTROL_SIZE) {
+        ::munmap(control, SHARED_CONTROL_SIZE);
+        ::close(fd);
+        throw std::runtime_error("Shared memory '" + name +
+                                 "' is smaller than its model");
+    }
+    void* addr = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd,
+                        SHARED_CONTROL_SIZE);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        ::munmap(control, SHARED_CONTROL_SIZE);
+        throw shared_error("Cannot map", name);
+    }
+    if (writable) control->n_attached.fetch_add(1);
+    if (counted) *counted = writable;
+    BinaryImage image;
+    image.size = size;
+    image.owner = std::shared_ptr<const void>(
+        addr, [control, size, writable](const void* p) {
+            ::munmap(const_cast<void*>(p), size);
+            if (writable) control->n_attached.fetch_sub(1);
+            ::munmap(control, SHARED_CONTROL_SIZE);
+        });
+    image.data = static_cast<const char*>(addr);
+    return image;
+}
+
+bool unlink_shared_image(const std::string& name) {
+    return ::shm_unlink(name.c_str()) == 0;
+}
+
+SharedImageInfo shared_image_info(const std::string& name) {
+    const int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) throw shared_error("Cannot open", name);
+    uint64_t segment_size;
+    bool pending;
+    SharedControl* control = map_control(fd, false, segment_size, pending);
+    ::close(fd);
+    if (!control) throw not_a_model(name, pending);
+    SharedImageInfo info;
+    info.generation = control->generation;
+    info.n_attached = control->n_attached.load();
+    info.size = control->size;
+    ::munmap(control, SHARED_CONTROL_SIZE);
+    return info;
+}
+#endif
+
+namespace smplxbin {
+
+bool is_smplxbin(const std::string& path) {
+    std::ifstream ifs(path, std::ios::binary);
+    char magic[sizeof(MAGIC)];
+    return ifs.read(magic, sizeof(magic)) &&
+           std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+void write_image(const Header& header, const void* const data[n_sections],
+                 char* out) {
+    std::memcpy(out, &header, sizeof(header));
+    uint64_t pos = sizeof(header);
+    for (size_t i = 0; i < n_sections; ++i) {
+        const SectionEntry& entry = header.sections[i];
+        if (!entry.size) continue;
+        std::memset(out + pos, 0, entry.offset - pos);
+        std::memcpy(out + entry.offset, data[i], entry.size);
+        pos = entry.offset + entry.size;
+    }
+}
+
+}  // namespace smplxbin
+}  // namespace internal
+}  // namespace smplx
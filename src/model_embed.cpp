@@ -0,0 +1,77 @@
+#include "smplx/internal/model_bin.hpp"
+
+#include <stdexcept>
+
+// Model images of SMPLX_EMBED_MODELS (see CMakeLists.txt), listed by the
+// generated smplx/embedded_models.inc as
+// SMPLX_EMBEDDED_MODEL(id, name, path), one per image. Each is assembled
+// into read-only data with .incbin, page-aligned as a mapped file is (its
+// sections need smplxbin::ALIGN), so it is used in place with no copy.
+#ifdef SMPLX_EMBED_MODELS
+#ifdef __APPLE__
+#define SMPLX_ASM_SYMBOL(sym) "_" #sym
+#define SMPLX_ASM_BEGIN ".const_data\n"
+#define SMPLX_ASM_END ".text\n"
+#else
+#define SMPLX_ASM_SYMBOL(sym) #sym
+#define SMPLX_ASM_BEGIN ".pushsection .rodata\n"
+#define SMPLX_ASM_END ".popsection\n"
+#endif
+
+#define SMPLX_EMBEDDED_MODEL(id, name, path)                                \
+    extern "C" const char smplx_embedded_##id[];                            \
+    extern "C" const char smplx_embedded_##id##_end[];                      \
+    __asm__(SMPLX_ASM_BEGIN ".p2align 12\n"                                 \
+            ".globl " SMPLX_ASM_SYMBOL(smplx_embedded_##id) "\n"            \
+            SMPLX_ASM_SYMBOL(smplx_embedded_##id) ":\n"                     \
+            ".incbin \"" path "\"\n"                                        \
+            ".globl " SMPLX_ASM_SYMBOL(smplx_embedded_##id##_end) "\n"      \
+            SMPLX_ASM_SYMBOL(smplx_embedded_##id##_end) ":\n"               \
+            SMPLX_ASM_END);
+#include "smplx/embedded_models.inc"
+#undef SMPLX_EMBEDDED_MODEL
+#endif
+
+namespace smplx {
+namespace internal {
+
+namespace {
+struct EmbeddedImage {
+    const char* name;
+    const char *begin, *end;
+};
+
+const EmbeddedImage EMBEDDED_IMAGES[] = {
+#ifdef SMPLX_EMBED_MODELS
+#define SMPLX_EMBEDDED_MODEL(id, name, path) \
+    {name, smplx_embedded_##id, smplx_embedded_##id##_end},
+#include "smplx/embedded_models.inc"
+#undef SMPLX_EMBEDDED_MODEL
+#endif
+    {nullptr, nullptr, nullptr}};
+}  // namespace
+
+BinaryImage embedded_image(const std::string& name) {
+    for (const EmbeddedImage* it = EMBEDDED_IMAGES; it->name; ++it) {
+        if (name != it->name) continue;
+        BinaryImage image;
+        image.data = it->begin;
+        image.size = it->end - it->begin;
+        // Static data, never freed; owned so the model counts as mapped
+        image.owner =
+            std::shared_ptr<const void>(image.data, [](const void*) {});
+        return image;
+    }
+    throw std::invalid_argument("No embedded model '" + name + "'");
+}
+
+std::vector<std::string> embedded_image_names() {
+    std::vector<std::string> names;
+    for (const EmbeddedImage* it = EMBEDDED_IMAGES; it->name; ++it) {
+        names.push_back(it->name);
+    }
+    return names;
+}
+
+}  // namespace internal
+}  // namespace smplx
@@ -0,0 +1,260 @@
+#include "smplx/model_registry.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+#include <vector>
+
+#include "smplx/thread_pool.hpp"
+#include "smplx/util.hpp"
+
+namespace smplx {
+namespace {
+template <class T>
+bool is_ready(const std::shared_future<T>& future) {
+    return future.wait_for(std::chrono::seconds(0)) ==
+           std::future_status::ready;
+}
+}  // namespace
+
+template <class ModelConfig>
+ModelRegistry<ModelConfig>::ModelRegistry(size_t memory_budget)
+    : _memory_budget(memory_budget) {}
+
+template <class ModelConfig>
+ModelRegistry<ModelConfig>::~ModelRegistry() {
+    std::vector<Entry> pending;
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        for (const auto& entry : _entries) {
+            if (entry.second.load) pending.push_back(entry.second);
+        }
+    }
+    for (const Entry& entry : pending) {
+        // Queued loads are run here rather than waited for
+        entry.load->run_once();
+        entry.model.wait();
+    }
+    // Loads finish with _mtx held; wait until the last one released it
+    std::lock_guard<std::mutex> lock(_mtx);
+}
+
+template <class ModelConfig>
+typename ModelRegistry<ModelConfig>::ModelPtr ModelRegistry<ModelConfig>::get(
+    Gender gender) {
+    return _find_or_load(Key("", "", gender), false).get();
+}
+
+template <class ModelConfig>
+typename ModelRegistry<ModelConfig>::ModelPtr ModelRegistry<ModelConfig>::get(
+    const std::string& path, const std::string& uv_path, Gender gender) {
+    return _find_or_load(Key(path, uv_path, gender), false).get();
+}
+
+template <class ModelConfig>
+void ModelRegistry<ModelConfig>::preload(Gender gender) {
+    _find_or_load(Key("", "", gender), true);
+}
+
+template <class ModelConfig>
+void ModelRegistry<ModelConfig>::preload(const std::string& path,
+                                         const std::string& uv_path,
+                                         Gender gender) {
+    _find_or_load(Key(path, uv_path, gender), true);
+}
+
+template <class ModelConfig>
+bool ModelRegistry<ModelConfig>::contains(Gender gender) const {
+    std::lock_guard<std::mutex> lock(_mtx);
+    return _entries.count(Key("", "", gender)) > 0;
+}
+
+template <class ModelConfig>
+bool ModelRegistry<ModelConfig>::contains(const std::string& path,
+                                          const std::string& uv_path,
+                                          Gender gender) const {
+    std::lock_guard<std::mutex> lock(_mtx);
+    return _entries.count(Key(path, uv_path, gender)) > 0;
+}
+
+template <class ModelConfig>
+void ModelRegistry<ModelConfig>::set_memory_budget(size_t bytes) {
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _memory_budget = bytes;
+    }
+    const Sizes sizes = _sizes();
+    std::lock_guard<std::mutex> lock(_mtx);
+    _evict(false, sizes);
+}
+
+template <class ModelConfig>
+size_t ModelRegistry<ModelConfig>::memory_budget() const {
+    std::lock_guard<std::mutex> lock(_mtx);
+    return _memory_budget;
+}
+
+template <class ModelConfig>
+size_t ModelRegistry<ModelConfig>::memory_usage() const {
+    size_t usage = 0;
+    for (const auto& size : _sizes()) usage += size.second;
+    return usage;
+}
+
+template <class ModelConfig>
+size_t ModelRegistry<ModelConfig>::size() const {
+    std::lock_guard<std::mutex> lock(_mtx);
+    return _entries.size();
+}
+
+template <class ModelConfig>
+void ModelRegistry<ModelConfig>::clear() {
+    std::lock_guard<std::mutex> lock(_mtx);
+    _evict(true, Sizes());
+}
+
+template <class ModelConfig>
+ModelRegistry<ModelConfig>& ModelRegistry<ModelConfig>::global() {
+    static ModelRegistry registry;
+    return registry;
+}
+
+template <class ModelConfig>
+std::shared_future<typename ModelRegistry<ModelConfig>::ModelPtr>
+ModelRegistry<ModelConfig>::_find_or_load(const Key& key, bool background) {
+    auto promise = std::make_shared<std::promise<ModelPtr>>();
+    auto load = std::make_shared<Load>();
+    std::shared_future<ModelPtr> future;
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        auto it = _entries.find(key);
+        if (it != _entries.end()) {
+            it->second.last_used = ++_clock;
+            future = it->second.model;
+            load = it->second.load;
+        } else {
+            future = promise->get_future().share();
+            _entries[key] = Entry{future, load, ++_clock};
+            load->run = [this, key, promise, background]() {
+                _load(key, *promise, background);
+            };
+            if (background) {
+                ThreadPool::global().push([load]() { load->run_once(); });
+            }
+        }
+    }
+    // Not started yet: load here rather than wait on the pool
+    if (load && !background) load->run_once();
+    return future;
+}
+
+template <class ModelConfig>
+void ModelRegistry<ModelConfig>::_load(const Key& key,
+                                       std::promise<ModelPtr>& promise,
+                                       bool background) {
+    const std::string& path = std::get<0>(key);
+    const Gender gender = std::get<2>(key);
+    ModelPtr model;
+    std::exception_ptr error;
+    try {
+        model.reset(path.empty() ? new Model<ModelConfig>(gender)
+                                 : new Model<ModelConfig>(
+                                       path, std::get<1>(key), gender));
+        if (model->verts.rows() == 0) {
+            throw std::runtime_error(
+                std::string("Cannot load ") + ModelConfig::model_name +
+                " model " +
+                (path.empty() ? util::gender_to_str(gender) : path));
+        }
+        if (background) model->preload();
+    } catch (...) {
+        error = std::current_exception();
+    }
+    Sizes sizes;
+    size_t size = 0;
+    if (!error && memory_budget()) {
+        sizes = _sizes();
+        size = model->memory_usage().total();
+    }
+    // The promise is set last with _mtx held, so the destructor may
+    // wait for it and then for _mtx
+    std::lock_guard<std::mutex> lock(_mtx);
+    if (error) {
+        // Retried by the next get()
+        _entries.erase(key);
+        promise.set_exception(error);
+        return;
+    }
+    _evict(false, sizes, size);
+    auto it = _entries.find(key);
+    if (it != _entries.end()) it->second.load.reset();
+    promise.set_value(model);
+}
+
+template <class ModelConfig>
+void ModelRegistry<ModelConfig>::_evict(bool all, const Sizes& sizes,
+                                        size_t loading) {
+    if (!all && _memory_budget == 0) return;
+    // Of ready entries; models loaded since sizes was taken count when
+    // they evict in turn
+    auto size_of = [&](const Entry& entry) -> size_t {
+        auto it = sizes.find(entry.model.get().get());
+        return it == sizes.end() ? 0 : it->second;
+    };
+    size_t usage = loading;
+    if (!all) {
+        for (const auto& entry : _entries) {
+            if (is_ready(entry.second.model)) usage += size_of(entry.second);
+        }
+    }
+    while (all || usage > _memory_budget) {
+        auto lru = _entries.end();
+        for (auto it = _entries.begin(); it != _entries.end(); ++it) {
+            // Failed loads are never left ready in _entries
+            const Entry& entry = it->second;
+            if (!is_ready(entry.model) || entry.model.get().use_count() > 1) {
+                continue;
+            }
+            if (lru == _entries.end() ||
+                entry.last_used < lru->second.last_used) {
+                lru = it;
+            }
+        }
+        if (lru == _entries.end()) break;
+        if (!all) usage -= std::min(usage, size_of(lru->second));
+        _entries.erase(lru);
+    }
+}
+
+template <class ModelConfig>
+typename ModelRegistry<ModelConfig>::Sizes ModelRegistry<ModelConfig>::_sizes()
+    const {
+    std::vector<ModelPtr> models;
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        for (const auto& entry : _entries) {
+            if (is_ready(entry.second.model)) {
+                models.push_back(entry.second.model.get());
+            }
+        }
+    }
+    // models is released on return, before _evict checks which models
+    // no one else holds
+    Sizes sizes;
+    for (const ModelPtr& model : models) {
+        sizes[model.get()] = model->memory_usage().total();
+    }
+    return sizes;
+}
+
+// Instantiations
+template class ModelRegistry<model_config::SMPL>;
+template class ModelRegistry<model_config::SMPL_v1>;
+template class ModelRegistry<model_config::SMPLH>;
+template class ModelRegistry<model_config::SMPLX>;
+template class ModelRegistry<model_config::SMPLXpca>;
+template class ModelRegistry<model_config::SMPLX_v1>;
+template class ModelRegistry<model_config::SMPLXpca_v1>;
+
+}  // namespace smplx
@@ -0,0 +1,482 @@
+#include "smplx/internal/npz.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include <zlib.h>
+
+#include "smplx/thread_pool.hpp"
+#include "smplx/util.hpp"
+
+namespace smplx {
+namespace internal {
+namespace {
+const uint32_t LOCAL_SIG = 0x04034b50, CENTRAL_SIG = 0x02014b50,
+               EOCD_SIG = 0x06054b50, ZIP64_EOCD_SIG = 0x06064b50,
+               ZIP64_LOCATOR_SIG = 0x07064b50;
+// 32-bit size or offset stored in the ZIP64 extra field instead
+const uint32_t ZIP64_SATURATED = 0xFFFFFFFF;
+
+// Little-endian integer at p
+template <class T>
+T field(const char* p) {
+    T value = 0;
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        value |= (T)(uint8_t)p[i] << (8 * i);
+    }
+    return value;
+}
+
+bool read_at(std::ifstream& file, uint64_t offset, char* out, size_t size) {
+    file.clear();
+    file.seekg(offset);
+    return (bool)file.read(out, size);
+}
+
+// Parse .npy header dict, e.g.
+// {'descr': '<f4', 'fortran_order': False, 'shape': (10475, 3), }
+bool parse_npy_dict(const std::string& dict, NpzReader::ArrayHeader& out) {
+    // Start of the value of key
+    auto value = [&](const char* key) {
+        size_t pos = dict.find(key);
+        if (pos == std::string::npos) return pos;
+        pos = dict.find(':', pos);
+        if (pos == std::string::npos) return pos;
+        return dict.find_first_not_of(" ", pos + 1);
+    };
+    const size_t descr = value("'descr'"), order = value("'fortran_order'"),
+                 shape = value("'shape'");
+    if (descr == std::string::npos || order == std::string::npos ||
+        shape == std::string::npos || dict.size() < descr + 4 ||
+        dict[shape] != '(') {
+        return false;
+    }
+    // Byte order: little-endian, native (assumed little-endian, as the
+    // rest of the library) or not applicable
+    const char byte_order = dict[descr + 1];
+    out.kind = dict[descr + 2];
+    out.word_size = std::strtoul(dict.c_str() + descr + 3, nullptr, 10);
+    if (byte_order == '>' || out.word_size == 0) return false;
+    // Unicode strings: size in UTF-32 characters
+    if (out.kind == 'U') out.word_size *= 4;
+    out.fortran_order = dict.compare(order, 4, "True") == 0;
+    out.shape.clear();
+    const size_t shape_end = dict.find(')', shape);
+    if (shape_end == std::string::npos) return false;
+    for (size_t pos = shape + 1; pos < shape_end;) {
+        pos = dict.find_first_of("0123456789", pos);
+        if (pos >= shape_end) break;
+        char* end;
+        out.shape.push_back(std::strtoull(dict.c_str() + pos, &end, 10));
+        pos = end - dict.c_str();
+    }
+    return true;
+}
+}  // namespace
+
+NpzReader::NpzReader(const std::string& path)
+    : _path(path), _file(path, std::ios::binary) {
+    auto fail = [&](const std::string& msg) {
+        throw std::runtime_error("Invalid npz '" + path + "': " + msg);
+    };
+    if (!_file) throw std::runtime_error("Cannot open '" + path + "'");
+    _file.seekg(0, std::ios::end);
+    const uint64_t file_size = _file.tellg();
+
+    // End of central directory record, followed by a comment < 64 KiB
+    const size_t tail_size =
+        (size_t)std::min<uint64_t>(file_size, 22 + 65535);
+    if (tail_size < 22) fail("truncated");
+    std::vector<char> tail(tail_size);
+    if (!read_at(_file, file_size - tail_size, tail.data(), tail_size)) {
+        fail("cannot read");
+    }
+    size_t eocd = tail_size;
+    for (size_t i = tail_size - 22 + 1; i-- > 0;) {
+        if (field<uint32_t>(&tail[i]) == EOCD_SIG) {
+            eocd = i;
+            break;
+        }
+    }
+    if (eocd == tail_size) fail("not a zip archive");
+    uint64_t n_entries = field<uint16_t>(&tail[eocd + 10]);
+    uint64_t dir_size = field<uint32_t>(&tail[eocd + 12]);
+    uint64_t dir_offset = field<uint32_t>(&tail[eocd + 16]);
+    if (n_entries == 0xFFFF || dir_size == ZIP64_SATURATED ||
+        dir_offset == ZIP64_SATURATED) {
+        // ZIP64 (e.g. numpy.savez of large arrays): the record is located
+        // by a locator just before the 32-bit one
+        const uint64_t eocd_pos = file_size - tail_size + eocd;
+        char locator[20], eocd64[56];
+        if (eocd_pos < sizeof(locator) ||
+            !read_at(_file, eocd_pos - sizeof(locator), locator,
+                     sizeof(locator)) ||
+            field<uint32_t>(locator) != ZIP64_LOCATOR_SIG ||
+            !read_at(_file, field<uint64_t>(locator + 8), eocd64,
+                     sizeof(eocd64)) ||
+            field<uint32_t>(eocd64) != ZIP64_EOCD_SIG) {
+            fail("bad ZIP64 end of central directory");
+        }
+        n_entries = field<uint64_t>(eocd64 + 32);
+        dir_size = field<uint64_t>(eocd64 + 40);
+        dir_offset = field<uint64_t>(eocd64 + 48);
+    }
+    if (dir_offset > file_size || dir_size > file_size - dir_offset) {
+        fail("bad central directory");
+    }
+
+    std::vector<char> dir(dir_size);
+    if (!read_at(_file, dir_offset, dir.data(), dir_size)) {
+        fail("cannot read central directory");
+    }
+    size_t pos = 0;
+    for (uint64_t i = 0; i < n_entries; ++i) {
+        if (pos + 46 > dir_size ||
+            field<uint32_t>(&dir[pos]) != CENTRAL_SIG) {
+            fail("bad central directory");
+        }
+        const char* entry = &dir[pos];
+        Member member;
+        member.method = field<uint16_t>(entry + 10);
+        member.compressed_size = field<uint32_t>(entry + 20);
+        member.size = field<uint32_t>(entry + 24);
+        member.offset = field<uint32_t>(entry + 42);
+        const size_t name_len = field<uint16_t>(entry + 28),
+                     extra_len = field<uint16_t>(entry + 30),
+                     comment_len = field<uint16_t>(entry + 32);
+        const size_t entry_size = 46 + name_len + extra_len + comment_len;
+        if (pos + entry_size > dir_size) fail("bad central directory");
+        std::string name(entry + 46, name_len);
+
+        // ZIP64 extra field: 64-bit values of the saturated fields, in
+        // this order
+        const char* extra = entry + 46 + name_len;
+        for (size_t e = 0; e + 4 <= extra_len;) {
+            const size_t id = field<uint16_t>(extra + e),
+                         len = field<uint16_t>(extra + e + 2);
+            if (e + 4 + len > extra_len) fail("bad extra field");
+            if (id == 1) {
+                const char *p = extra + e + 4, *end = p + len;
+                for (uint64_t* value : {&member.size, &member.compressed_size,
+                                        &member.offset}) {
+                    if (*value != ZIP64_SATURATED) continue;
+                    if (p + 8 > end) fail("bad ZIP64 extra field");
+                    *value = field<uint64_t>(p);
+                    p += 8;
+                }
+            }
+            e += 4 + len;
+        }
+        if (name.size() > 4 &&
+            name.compare(name.size() - 4, 4, ".npy") == 0) {
+            name.erase(name.size() - 4);
+        }
+        _members[name] = member;
+        pos += entry_size;
+    }
+}
+
+size_t NpzReader::ArrayHeader::n_values() const {
+    size_t n = 1;
+    for (size_t d : shape) n *= d;
+    return n;
+}
+
+void NpzReader::stream(
+    const std::string& name,
+    const std::function<void(const ArrayHeader&)>& on_header,
+    const std::function<void(const char*, size_t, size_t)>& on_data) const {
+    auto it = _members.find(name);
+    if (it == _members.end()) {
+        throw std::runtime_error("Array '" + name + "' not found in '" +
+                                 _path + "'");
+    }
+    auto fail = [&](const std::string& msg) {
+        throw std::runtime_error("Cannot load array '" + name + "' from '" +
+                                 _path + "': " + msg);
+    };
+    const Member& member = it->second;
+    if (member.method != 0 && member.method != 8) {
+        fail("unsupported compression");
+    }
+
+    uint64_t data_offset;
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        char header[30];
+        if (!read_at(_file, member.offset, header, sizeof(header)) ||
+            field<uint32_t>(header) != LOCAL_SIG) {
+            fail("bad local header");
+        }
+        // Name and extra field lengths may differ from the central
+        // directory's
+        data_offset = member.offset + sizeof(header) +
+                      field<uint16_t>(header + 26) +
+                      field<uint16_t>(header + 28);
+    }
+
+    // Consumer of the .npy bytes, in order: magic, version, header length,
+    // header dict, then the values, handed over in place except for those
+    // split across chunks
+    std::string npy_header;
+    bool header_done = false;
+    ArrayHeader header;
+    size_t n_values = 0, n_done = 0;
+    // Value split across chunks
+    std::vector<char> partial;
+    size_t n_partial = 0;
+    auto consume = [&](const char* p, size_t n) {
+        if (!header_done) {
+            const size_t prev = npy_header.size();
+            npy_header.append(p, n);
+            if (npy_header.size() < 12) return;
+            if (npy_header.compare(0, 6, "\x93NUMPY") ||
+                npy_header[6] < 1 || npy_header[6] > 3) {
+                fail("unsupported .npy version");
+            }
+            // Version 1 has a 16-bit header length, later ones 32-bit
+            const size_t dict_begin = npy_header[6] == 1 ? 10 : 12;
+            const size_t header_end =
+                dict_begin + (npy_header[6] == 1
+                                  ? field<uint16_t>(&npy_header[8])
+                                  : field<uint32_t>(&npy_header[8]));
+            if (npy_header.size() < header_end) return;
+            if (!parse_npy_dict(npy_header.substr(dict_begin,
+                                                  header_end - dict_begin),
+                                header)) {
+                fail("unsupported .npy header");
+            }
+            n_values = header.n_values();
+            partial.resize(header.word_size);
+            header_done = true;
+            on_header(header);
+            p += header_end - prev;
+            n = prev + n - header_end;
+        }
+        const size_t word = header.word_size;
+        if (n_partial) {
+            const size_t m = std::min(n, word - n_partial);
+            std::memcpy(partial.data() + n_partial, p, m);
+            n_partial += m;
+            p += m;
+            n -= m;
+            if (n_partial < word) return;
+            if (n_done >= n_values) fail("size does not match shape");
+            on_data(partial.data(), n_done++, 1);
+            n_partial = 0;
+        }
+        const size_t count = n / word;
+        if (count) {
+            if (count > n_values - n_done) fail("size does not match shape");
+            on_data(p, n_done, count);
+            n_done += count;
+        }
+        n_partial = n - count * word;
+        std::memcpy(partial.data(), p + count * word, n_partial);
+    };
+
+    const size_t chunk = (size_t)1 << 20;
+    std::vector<char> in(std::min<uint64_t>(chunk, member.compressed_size));
+    std::vector<char> out(member.method ? chunk : 0);
+    z_stream zs;
+    std::memset(&zs, 0, sizeof(zs));
+    if (member.method && inflateInit2(&zs, -MAX_WBITS) != Z_OK) {
+        fail("zlib error");
+    }
+    // Release the zlib state on all exits
+    std::unique_ptr<z_stream, int (*)(z_stream*)> zs_guard(
+        member.method ? &zs : nullptr, inflateEnd);
+    int err = Z_OK;
+    for (uint64_t pos = 0; pos < member.compressed_size;) {
+        const size_t n =
+            (size_t)std::min<uint64_t>(chunk, member.compressed_size - pos);
+        {
+            std::lock_guard<std::mutex> lock(_mtx);
+            if (!read_at(_file, data_offset + pos, in.data(), n)) {
+                fail("truncated");
+            }
+        }
+        pos += n;
+        if (!member.method) {
+            consume(in.data(), n);
+            continue;
+        }
+        zs.next_in = reinterpret_cast<Bytef*>(in.data());
+        zs.avail_in = (uInt)n;
+        do {
+            zs.next_out = reinterpret_cast<Bytef*>(out.data());
+            zs.avail_out = (uInt)chunk;
+            err = inflate(&zs, Z_NO_FLUSH);
+            if (err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR) {
+                fail("corrupt");
+            }
+            consume(out.data(), chunk - zs.avail_out);
+        } while (err == Z_OK && zs.avail_out == 0);
+        if (err == Z_STREAM_END) break;
+    }
+    if ((member.method && (err != Z_STREAM_END || zs.total_out != member.size))
+        || !header_done || n_done != n_values || n_partial) {
+        fail("corrupt or truncated");
+    }
+}
+
+template <class T, class Func>
+void NpzReader::_for_each(const std::string& name,
+                          std::initializer_list<size_t> shape,
+                          Func f) const {
+    // (rows, cols) view; values of the minor dimension are consecutive
+    size_t rows = 0, cols = 0, minor_size = 0;
+    bool fortran_order = false;
+    std::function<void(const char*, size_t, size_t)> convert;
+    auto on_header = [&](const ArrayHeader& header) {
+        if (header.shape.size() != shape.size() ||
+            !std::equal(shape.begin(), shape.end(), header.shape.begin())) {
+            std::string expected, got;
+            for (size_t d : shape) expected += std::to_string(d) + ",";
+            for (size_t d : header.shape) got += std::to_string(d) + ",";
+            throw std::runtime_error("Array '" + name + "' in '" + _path +
+                                     "' has shape (" + got +
+                                     "), expected (" + expected + ")");
+        }
+        cols = shape.size() > 1 ? *(shape.end() - 1) : 1;
+        rows = cols ? header.n_values() / cols : 0;
+        fortran_order = header.fortran_order;
+        minor_size = fortran_order ? rows : cols;
+        auto make = [&](auto tag) {
+            using Src = decltype(tag);
+            convert = [&](const char* p, size_t first, size_t count) {
+                size_t major = first / minor_size, minor = first % minor_size;
+                for (size_t k = 0; k < count; ++k) {
+                    Src value;
+                    std::memcpy(&value, p + k * sizeof(Src), sizeof(Src));
+                    if (fortran_order) {
+                        f(minor, major, static_cast<T>(value));
+                    } else {
+                        f(major, minor, static_cast<T>(value));
+                    }
+                    if (++minor == minor_size) {
+                        minor = 0;
+                        ++major;
+                    }
+                }
+            };
+        };
+        const char kind = header.kind;
+        const size_t word = header.word_size;
+        if (kind == 'f' && word == 4) {
+            make(float());
+        } else if (kind == 'f' && word == 8) {
+            make(double());
+        } else if (kind == 'i' && word == 4) {
+            make(int32_t());
+        } else if (kind == 'i' && word == 8) {
+            make(int64_t());
+        } else if (kind == 'u' && word == 4) {
+            make(uint32_t());
+        } else if (kind == 'u' && word == 8) {
+            make(uint64_t());
+        } else {
+            throw std::runtime_error("Array '" + name + "' in '" + _path +
+                                     "' has an unsupported dtype");
+        }
+    };
+    stream(name, on_header, [&](const char* p, size_t first, size_t count) {
+        convert(p, first, count);
+    });
+}
+
+void NpzReader::load_into(const std::string& name,
+                          std::initializer_list<size_t> shape, Scalar* out,
+                          size_t row_stride, size_t col_stride) const {
+    _for_each<Scalar>(name, shape, [&](size_t i, size_t j, Scalar value) {
+        out[i * row_stride + j * col_stride] = value;
+    });
+}
+
+void NpzReader::load_into(const std::string& name,
+                          std::initializer_list<size_t> shape, Index* out,
+                          size_t row_stride, size_t col_stride) const {
+    _for_each<Index>(name, shape, [&](size_t i, size_t j, Index value) {
+        out[i * row_stride + j * col_stride] = value;
+    });
+}
+
+void NpzReader::load_cols_into(const std::string& name,
+                               std::initializer_list<size_t> shape,
+                               const std::vector<int>& col_map, Scalar* out,
+                               size_t row_stride, size_t col_stride) const {
+    const size_t n_cols = shape.size() > 1 ? *(shape.end() - 1) : 1;
+    _SMPLX_ASSERT_EQ(col_map.size(), n_cols);
+    _for_each<Scalar>(name, shape, [&](size_t i, size_t j, Scalar value) {
+        const int col = col_map[j];
+        if (col >= 0) out[i * row_stride + col * col_stride] = value;
+    });
+}
+
+void NpzReader::load_sparse(const std::string& name,
+                            std::initializer_list<size_t> shape,
+                            SparseMatrix& out) const {
+    _SMPLX_ASSERT_EQ(shape.size(), 2);
+    std::vector<Eigen::Triplet<Scalar, int>> triplets;
+    _for_each<Scalar>(name, shape, [&](size_t i, size_t j, Scalar value) {
+        if (value != 0.f) triplets.emplace_back(i, j, value);
+    });
+    out.resize(*shape.begin(), *(shape.end() - 1));
+    out.setFromTriplets(triplets.begin(), triplets.end());
+    out.makeCompressed();
+}
+
+cnpy::NpyArray NpzReader::load(const std::string& name) const {
+    cnpy::NpyArray array;
+    stream(
+        name,
+        [&](const ArrayHeader& header) {
+            array = cnpy::NpyArray(header.shape, header.word_size,
+                                   header.fortran_order);
+        },
+        [&](const char* p, size_t first, size_t count) {
+            std::memcpy(array.data<char>() + first * array.word_size, p,
+                        count * array.word_size);
+        });
+    return array;
+}
+
+std::map<std::string, cnpy::NpyArray> NpzReader::load_all(
+    const std::vector<std::string>& names) const {
+    std::map<std::string, cnpy::NpyArray> arrays;
+    std::vector<std::function<void()>> tasks;
+    for (const std::string& name : names) {
+        if (!contains(name) || arrays.count(name)) continue;
+        // Map nodes are stable, so each task fills its own
+        cnpy::NpyArray& array = arrays[name];
+        tasks.push_back([this, &name, &array]() { array = load(name); });
+    }
+    run_concurrently(tasks);
+    return arrays;
+}
+
+void NpzReader::run_concurrently(
+    const std::vector<std::function<void()>>& tasks) {
+    std::vector<std::exception_ptr> errors(tasks.size());
+    ThreadPool::global().parallel_for(
+        tasks.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                // Exceptions must not escape pool workers
+                try {
+                    tasks[i]();
+                } catch (...) {
+                    errors[i] = std::current_exception();
+                }
+            }
+        });
+    for (const auto& error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+}
+
+}  // namespace internal
+}  // namespace smplx
@@ -0,0 +1,137 @@
+#include "smplx/pose_cache.hpp"
+
+#include <cmath>
+#include <stdexcept>
+
+namespace smplx {
+
+// Components of two poses in one cell differ by less than step, so the
+// angle-axis vectors of a joint by less than sqrt(3) * step = tolerance;
+// the exponential map does not increase distances, so neither do the
+// rotations.
+PoseCache::PoseCache(size_t capacity, Scalar tolerance)
+    : _capacity(capacity),
+      _tolerance(tolerance),
+      _step(tolerance / std::sqrt(3.f)) {
+    if (capacity == 0 || !(tolerance > 0.f)) {
+        throw std::invalid_argument(
+            "PoseCache capacity and tolerance must be positive");
+    }
+}
+
+size_t PoseCache::KeyHash::operator()(const Key& key) const {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    auto add = [&](uint64_t x) {
+        hash ^= x;
+        hash *= 1099511628211ULL;
+    };
+    add((uint64_t)(uintptr_t)key.model);
+    add(key.generation);
+    for (int32_t x : key.cell) add((uint32_t)x);
+    return (size_t)hash;
+}
+
+PoseCache::Key PoseCache::_key(const void* model, uint64_t generation,
+                               const Vector& full_pose) const {
+    // Root rotation does not affect the pose blend shapes
+    Key key{model, generation, std::vector<int32_t>(full_pose.size() - 3)};
+    for (size_t i = 3; i < (size_t)full_pose.size(); ++i) {
+        key.cell[i - 3] = (int32_t)std::floor(full_pose[i] / _step);
+    }
+    return key;
+}
+
+bool PoseCache::_near(const Entry& entry, const Vector& pose) const {
+    if (entry.pose.size() != pose.size()) return false;
+    const Scalar tol_sq = _tolerance * _tolerance;
+    for (size_t i = 0; i < (size_t)pose.size(); i += 3) {
+        if ((entry.pose.segment<3>(i) - pose.segment<3>(i)).squaredNorm() >
+            tol_sq) {
+            return false;
+        }
+    }
+    return true;
+}
+
+PoseCache::Offsets PoseCache::find(const void* model, uint64_t generation,
+                                   const Vector& full_pose) {
+    const Key key = _key(model, generation, full_pose);
+    std::vector<EntryPtr> entries;
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        auto it = _index.find(key);
+        if (it != _index.end()) {
+            ++_hits;
+            _lru.splice(_lru.begin(), _lru, it->second);
+            return (*it->second)->offsets;
+        }
+        entries.assign(_lru.begin(), _lru.end());
+    }
+    // Near poses are often in neighboring cells; cheap next to computing
+    // the offsets, and scanned unlocked so other lookups are not held up
+    const Vector pose = full_pose.tail(full_pose.size() - 3);
+    EntryPtr found;
+    for (const EntryPtr& entry : entries) {
+        if (entry->key.model == model && entry->key.generation == generation &&
+            _near(*entry, pose)) {
+            found = entry;
+            break;
+        }
+    }
+    std::lock_guard<std::mutex> lock(_mtx);
+    if (!found) {
+        ++_misses;
+        return nullptr;
+    }
+    ++_hits;
+    // Unless evicted since the scan
+    auto it = _index.find(found->key);
+    if (it != _index.end() && *it->second == found) {
+        _lru.splice(_lru.begin(), _lru, it->second);
+    }
+    return found->offsets;
+}
+
+void PoseCache::insert(const void* model, uint64_t generation,
+                       const Vector& full_pose, Offsets offsets) {
+    auto entry = std::make_shared<Entry>(
+        Entry{_key(model, generation, full_pose),
+              full_pose.tail(full_pose.size() - 3), std::move(offsets)});
+    std::lock_guard<std::mutex> lock(_mtx);
+    if (_index.count(entry->key)) return;
+    if (_lru.size() >= _capacity) {
+        _index.erase(_lru.back()->key);
+        _lru.pop_back();
+    }
+    _lru.push_front(std::move(entry));
+    _index.emplace(_lru.front()->key, _lru.begin());
+}
+
+void PoseCache::clear() {
+    std::lock_guard<std::mutex> lock(_mtx);
+    _index.clear();
+    _lru.clear();
+}
+
+size_t PoseCache::size() const {
+    std::lock_guard<std::mutex> lock(_mtx);
+    return _lru.size();
+}
+
+size_t PoseCache::hits() const {
+    std::lock_guard<std::mutex> lock(_mtx);
+    return _hits;
+}
+
+size_t PoseCache::misses() const {
+    std::lock_guard<std::mutex> lock(_mtx);
+    return _misses;
+}
+
+void PoseCache::reset_stats() {
+    std::lock_guard<std::mutex> lock(_mtx);
+    _hits = _misses = 0;
+}
+
+}  // namespace smplx
@@ -1,8 +1,11 @@
 #include "smplx/sequence.hpp"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <cnpy.h>
+#include "smplx/internal/cpu_kernels.hpp"
+#include "smplx/internal/npz.hpp"
 #include "smplx/util.hpp"
 #include "smplx/util_cnpy.hpp"
 
@@ -10,6 +13,11 @@ namespace smplx {
 
 namespace {
 using util::assert_shape;
+using RotationMap = Eigen::Map<Eigen::Matrix<Scalar, 3, 3, Eigen::RowMajor>>;
+using RotationConstMap =
+    Eigen::Map<const Eigen::Matrix<Scalar, 3, 3, Eigen::RowMajor>>;
+using TransformConstMap =
+    Eigen::Map<const Eigen::Matrix<Scalar, 3, 4, Eigen::RowMajor>>;
 }  // namespace
 
 // AMASS npz structure
@@ -44,7 +52,10 @@ bool Sequence<SequenceConfig>::load(const std::string& path) {
         return false;
     }
     // ** READ NPZ **
-    cnpy::npz_t npz = cnpy::npz_load(path);
+    // Members are inflated concurrently
+    const internal::NpzReader reader(path);
+    cnpy::npz_t npz =
+        reader.load_all({"trans", "poses", "betas", "dmpls", "gender"});
 
     if (npz.count("trans") != 1 || npz.count("poses") != 1 ||
         npz.count("betas") != 1) {
@@ -67,12 +78,12 @@ bool Sequence<SequenceConfig>::load(const std::string& path) {
     auto& shape_raw = npz["betas"];
     assert_shape(shape_raw, {SequenceConfig::n_shape_params()});
     shape =
-        util::load_float_matrix(poses_raw, SequenceConfig::n_shape_params(), 1);
+        util::load_float_matrix(shape_raw, SequenceConfig::n_shape_params(), 1);
 
     if (SequenceConfig::n_dmpls() && npz.count("dmpls") == 1) {
         auto& dmpls_raw = npz["dmpls"];
         assert_shape(dmpls_raw, {n_frames, SequenceConfig::n_dmpls()});
-        dmpls = util::load_float_matrix(poses_raw, n_frames,
+        dmpls = util::load_float_matrix(dmpls_raw, n_frames,
                                         SequenceConfig::n_dmpls());
     }
 
@@ -106,7 +117,225 @@ bool Sequence<SequenceConfig>::load(const std::string& path) {
     return true;
 }
 
+template <class SequenceConfig, class ModelConfig>
+SequenceEvaluator<SequenceConfig, ModelConfig>::SequenceEvaluator(
+    const Sequence<SequenceConfig>& seq, Body<ModelConfig>& body,
+    Scalar max_error, SequenceInterp interp)
+    : seq(seq), body(body), max_error(max_error), interp(interp) {
+    const auto& model = body.model;
+    const auto& kernels = internal::cpu_kernels();
+    const size_t n_frames = seq.n_frames, n_joints = model.n_joints(),
+                 n_verts = model.n_verts(), n_shape = model.n_shape_blends();
+    if (n_frames == 0) return;
+    model.require({ModelComponent::shape_blends, ModelComponent::pose_blends});
+    seq.set_shape(body);
+
+    // Shaped joints are the same in every frame
+    _frame.joints_shaped = model.joint_reg * model.verts;
+    if (body.template_offsets()) {
+        _frame.joints_shaped.noalias() +=
+            model.joint_reg * *body.template_offsets();
+    }
+    Eigen::Map<Vector>(_frame.joints_shaped.data(), 3 * n_joints).noalias() +=
+        model.joint_shape_blends * body.shape();
+    _frame.joint_transforms.resize(n_joints, 12);
+
+    const bool vertices = interp == SequenceInterp::vertices;
+    _rotations.resize(n_frames * n_joints * 9);
+    if (vertices) _transforms.resize(n_frames * n_joints * 12);
+    for (size_t t = 0; t < n_frames; ++t) {
+        seq.set_pose(body, t);
+        const Vector full_pose = body.full_pose();
+        kernels.rodrigues(full_pose.data(), _frame.joint_transforms.data(),
+                          n_joints);
+        for (size_t j = 0; j < n_joints; ++j) {
+            RotationMap(&_rotations[(t * n_joints + j) * 9]).noalias() =
+                TransformConstMap(_frame.joint_transforms.row(j).data())
+                    .template leftCols<3>();
+        }
+        if (vertices) {
+            internal::local_to_global<ModelConfig>(body.trans(), _frame);
+            std::copy(_frame.joint_transforms.data(),
+                      _frame.joint_transforms.data() + n_joints * 12,
+                      &_transforms[t * n_joints * 12]);
+        }
+    }
+
+    // A joint's pose blend shapes are 9 columns; accumulate per-vertex
+    // squared norms column by column
+    _blend_norm.assign(n_joints, 0.f);
+    std::vector<Scalar> sq_norm(n_verts);
+    for (size_t j = 1; j < n_joints; ++j) {
+        std::fill(sq_norm.begin(), sq_norm.end(), 0.f);
+        for (size_t c = 0; c < 9; ++c) {
+            const Scalar* col =
+                model.blend_shapes.col(n_shape + 9 * (j - 1) + c).data();
+            for (size_t v = 0; v < n_verts; ++v) {
+                sq_norm[v] += col[3 * v] * col[3 * v] +
+                              col[3 * v + 1] * col[3 * v + 1] +
+                              col[3 * v + 2] * col[3 * v + 2];
+            }
+        }
+        _blend_norm[j] =
+            std::sqrt(*std::max_element(sq_norm.begin(), sq_norm.end()));
+    }
+
+    if (vertices) {
+        // Lever arms of the joint transforms, from the first frame
+        const Points& verts_shaped = _key(0, -1).verts_shaped;
+        const SparseMatrix& weights =
+            body.lod() ? model.lod(body.lod()).weights : model.weights;
+        _skin_radius.assign(n_joints, 0.f);
+        for (size_t v = 0; v < (size_t)verts_shaped.rows(); ++v) {
+            const Scalar r = verts_shaped.row(v).norm();
+            for (SparseMatrix::InnerIterator it(weights, v); it; ++it) {
+                _skin_radius[it.col()] = std::max(_skin_radius[it.col()], r);
+            }
+        }
+    }
+
+    // Greedily take the furthest next keyframe with all frames in between
+    // within max_error: gallop, then bisect
+    _keyframes.push_back(0);
+    for (size_t a = 0; a + 1 < n_frames;) {
+        size_t good = a + 1, bad = n_frames;
+        for (size_t step = 2; good + 1 < n_frames; step *= 2) {
+            const size_t b = std::min(a + step, n_frames - 1);
+            if (!_segment_ok(a, b)) {
+                bad = b;
+                break;
+            }
+            good = b;
+        }
+        while (bad < n_frames && bad - good > 1) {
+            const size_t mid = (good + bad) / 2;
+            if (_segment_ok(a, mid)) {
+                good = mid;
+            } else {
+                bad = mid;
+            }
+        }
+        _keyframes.push_back(good);
+        a = good;
+    }
+}
+
+template <class SequenceConfig, class ModelConfig>
+const Points& SequenceEvaluator<SequenceConfig, ModelConfig>::verts(
+    size_t frame) {
+    _SMPLX_ASSERT_LT(frame, seq.n_frames);
+    const auto it =
+        std::upper_bound(_keyframes.begin(), _keyframes.end(), frame);
+    const size_t a = *(it - 1);
+    if (a == frame) {
+        return _key(a, it == _keyframes.end() ? -1 : *it).verts;
+    }
+    const size_t b = *it;
+    const Key& key_a = _key(a, b);
+    const Key& key_b = _key(b, a);
+    const Scalar s = Scalar(frame - a) / (b - a);
+    if (interp == SequenceInterp::vertices) {
+        _verts.noalias() = (1.f - s) * key_a.verts + s * key_b.verts;
+        return _verts;
+    }
+
+    const auto& model = body.model;
+    const auto& kernels = internal::cpu_kernels();
+    _verts_shaped.noalias() =
+        (1.f - s) * key_a.verts_shaped + s * key_b.verts_shaped;
+    seq.set_pose(body, frame);
+    const Vector full_pose = body.full_pose();
+    kernels.rodrigues(full_pose.data(), _frame.joint_transforms.data(),
+                      model.n_joints());
+    internal::local_to_global<ModelConfig>(body.trans(), _frame);
+    const SparseMatrix& weights =
+        body.lod() ? model.lod(body.lod()).weights : model.weights;
+    _verts.resize(_verts_shaped.rows(), 3);
+    kernels.lbs(weights.outerIndexPtr(), weights.innerIndexPtr(),
+                weights.valuePtr(), _frame.joint_transforms.data(),
+                _verts_shaped.data(), _verts.data(), nullptr, 0,
+                _verts.rows());
+    return _verts;
+}
+
+template <class SequenceConfig, class ModelConfig>
+Scalar SequenceEvaluator<SequenceConfig, ModelConfig>::error_bound(
+    size_t frame) const {
+    _SMPLX_ASSERT_LT(frame, seq.n_frames);
+    const auto it =
+        std::upper_bound(_keyframes.begin(), _keyframes.end(), frame);
+    const size_t a = *(it - 1);
+    return a == frame ? 0.f : _bound(a, *it, frame);
+}
+
+// Pose blend shapes are linear in the rotation matrices, so interpolating
+// shaped vertices errs by at most sum_j |B_j|_F |R_j - lerp(R_j)|_F, and
+// LBS with convex weights does not increase this. Interpolating posed
+// vertices additionally errs by |A_k - lerp(A_k)| applied to the vertices
+// skinned by each joint k.
+template <class SequenceConfig, class ModelConfig>
+Scalar SequenceEvaluator<SequenceConfig, ModelConfig>::_bound(size_t a,
+                                                              size_t b,
+                                                              size_t t) const {
+    const size_t n_joints = body.model.n_joints();
+    const Scalar s = Scalar(t - a) / (b - a);
+    Scalar err = 0.f;
+    for (size_t j = 1; j < n_joints; ++j) {
+        auto rot = [&](size_t frame) {
+            return RotationConstMap(&_rotations[(frame * n_joints + j) * 9]);
+        };
+        err += _blend_norm[j] *
+               (rot(t) - (1.f - s) * rot(a) - s * rot(b)).norm();
+    }
+    if (interp == SequenceInterp::vertices) {
+        Scalar rigid = 0.f;
+        for (size_t k = 0; k < n_joints; ++k) {
+            auto transform = [&](size_t frame) {
+                return TransformConstMap(
+                    &_transforms[(frame * n_joints + k) * 12]);
+            };
+            const Eigen::Matrix<Scalar, 3, 4, Eigen::RowMajor> diff =
+                transform(t) - (1.f - s) * transform(a) - s * transform(b);
+            rigid = std::max(rigid, diff.template leftCols<3>().norm() *
+                                            _skin_radius[k] +
+                                        diff.template rightCols<1>().norm());
+        }
+        err += rigid;
+    }
+    return err;
+}
+
+template <class SequenceConfig, class ModelConfig>
+bool SequenceEvaluator<SequenceConfig, ModelConfig>::_segment_ok(
+    size_t a, size_t b) const {
+    for (size_t t = a + 1; t < b; ++t) {
+        if (_bound(a, b, t) > max_error) return false;
+    }
+    return true;
+}
+
+template <class SequenceConfig, class ModelConfig>
+const typename SequenceEvaluator<SequenceConfig, ModelConfig>::Key&
+SequenceEvaluator<SequenceConfig, ModelConfig>::_key(size_t frame,
+                                                     size_t other) {
+    for (const Key& key : _keys) {
+        if (key.frame == frame) return key;
+    }
+    Key& key = _keys[0].frame == other ? _keys[1] : _keys[0];
+    seq.set_pose(body, frame);
+    body.update();
+    key.frame = frame;
+    key.verts = body.verts();
+    key.verts_shaped = body.verts_shaped();
+    return key;
+}
+
 // Instantiation
 template class Sequence<sequence_config::AMASS>;
+template class SequenceEvaluator<sequence_config::AMASS, model_config::SMPL>;
+template class SequenceEvaluator<sequence_config::AMASS, model_config::SMPLH>;
+template class SequenceEvaluator<sequence_config::AMASS, model_config::SMPLX>;
+template class SequenceEvaluator<sequence_config::AMASS,
+                                 model_config::SMPLX_v1>;
 
 }  // namespace smplx
@@ -0,0 +1,111 @@
+#include "smplx/internal/shared_array.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+namespace smplx {
+namespace internal {
+namespace {
+// FNV-1a over size bytes at data, continuing from hash
+uint64_t hash_bytes(const void* data, size_t size, uint64_t hash) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+const uint64_t HASH_INIT = 14695981039346656037ULL;
+
+template <class T>
+uint64_t content_hash(const T& a) {
+    const uint64_t dims[2] = {(uint64_t)a.rows(), (uint64_t)a.cols()};
+    return hash_bytes(a.data(), a.size() * sizeof(a.data()[0]),
+                      hash_bytes(dims, sizeof(dims), HASH_INIT));
+}
+template <class T>
+bool same_content(const T& a, const T& b) {
+    return a.rows() == b.rows() && a.cols() == b.cols() &&
+           (a.size() == 0 ||
+            std::memcmp(a.data(), b.data(), a.size() * sizeof(a.data()[0])) ==
+                0);
+}
+
+// Hashed and compared as CSR arrays, so must be compressed (see compress)
+uint64_t content_hash(const SparseMatrix& a) {
+    const uint64_t dims[3] = {(uint64_t)a.rows(), (uint64_t)a.cols(),
+                              (uint64_t)a.nonZeros()};
+    uint64_t hash = hash_bytes(dims, sizeof(dims), HASH_INIT);
+    hash = hash_bytes(a.outerIndexPtr(), (a.outerSize() + 1) * sizeof(int),
+                      hash);
+    hash = hash_bytes(a.innerIndexPtr(), a.nonZeros() * sizeof(int), hash);
+    return hash_bytes(a.valuePtr(), a.nonZeros() * sizeof(Scalar), hash);
+}
+bool same_content(const SparseMatrix& a, const SparseMatrix& b) {
+    if (a.rows() != b.rows() || a.cols() != b.cols() ||
+        a.nonZeros() != b.nonZeros() ||
+        std::memcmp(a.outerIndexPtr(), b.outerIndexPtr(),
+                    (a.outerSize() + 1) * sizeof(int))) {
+        return false;
+    }
+    const size_t nnz = a.nonZeros();
+    return nnz == 0 ||
+           (std::memcmp(a.innerIndexPtr(), b.innerIndexPtr(),
+                        nnz * sizeof(int)) == 0 &&
+            std::memcmp(a.valuePtr(), b.valuePtr(), nnz * sizeof(Scalar)) ==
+                0);
+}
+
+// Put value in the layout content_hash reads
+template <class T>
+void compress(T& value) {}
+void compress(SparseMatrix& value) { value.makeCompressed(); }
+
+// Arrays of type T in use, by content hash
+template <class T>
+struct Table {
+    std::mutex mtx;
+    std::unordered_multimap<uint64_t, std::weak_ptr<const T>> arrays;
+};
+template <class T>
+Table<T>& table() {
+    static Table<T> table;
+    return table;
+}
+}  // namespace
+
+template <class T>
+std::shared_ptr<const T> share_array(T&& value) {
+    compress(value);
+    const uint64_t hash = content_hash(value);
+    Table<T>& tab = table<T>();
+    std::lock_guard<std::mutex> lock(tab.mtx);
+    auto range = tab.arrays.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        std::shared_ptr<const T> array = it->second.lock();
+        if (array && same_content(*array, value)) return array;
+    }
+    // Drop the entries of arrays no longer used, so the table holds at
+    // most those in use plus the ones freed since the last insert
+    for (auto it = tab.arrays.begin(); it != tab.arrays.end();) {
+        if (it->second.expired()) {
+            it = tab.arrays.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    std::shared_ptr<const T> array = std::make_shared<T>(std::move(value));
+    tab.arrays.emplace(hash, array);
+    return array;
+}
+
+// Instantiations
+template std::shared_ptr<const Triangles> share_array(Triangles&&);
+template std::shared_ptr<const Points2D> share_array(Points2D&&);
+template std::shared_ptr<const IndexVector> share_array(IndexVector&&);
+template std::shared_ptr<const SparseMatrix> share_array(SparseMatrix&&);
+
+}  // namespace internal
+}  // namespace smplx
@@ -0,0 +1,102 @@
+#include "smplx/thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace smplx {
+
+ThreadPool::ThreadPool(size_t n_threads) {
+    if (n_threads == 0) {
+        n_threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }
+    _workers.reserve(n_threads);
+    for (size_t i = 0; i < n_threads; ++i) {
+        _workers.emplace_back([this] { _worker_loop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _stop = true;
+    }
+    _cv.notify_all();
+    for (auto& worker : _workers) worker.join();
+}
+
+void ThreadPool::push(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _tasks.push_back(std::move(task));
+    }
+    _cv.notify_one();
+}
+
+void ThreadPool::parallel_for(size_t n,
+                              const std::function<void(size_t, size_t)>& func,
+                              size_t n_threads) {
+    if (n == 0) return;
+    if (n_threads == 0 || n_threads > _workers.size() + 1) {
+        n_threads = _workers.size() + 1;
+    }
+    if (n_threads <= 1 || n == 1) {
+        func(0, n);
+        return;
+    }
+    // A few chunks per thread for load balancing; rounding up the chunk
+    // size may leave fewer chunks, none of them empty
+    const size_t chunk_size = (n - 1) / std::min(n, n_threads * 4) + 1;
+    const size_t n_chunks = (n - 1) / chunk_size + 1;
+
+    struct State {
+        std::atomic<size_t> next{0};
+        size_t done = 0;
+        std::mutex mtx;
+        std::condition_variable cv;
+    };
+    // Shared so that helpers which start after we return don't dangle
+    auto state = std::make_shared<State>();
+    // Claim and run chunks until none are left. Only chunks actually claimed
+    // are waited on, so this never blocks on a task stuck in the queue.
+    auto run_chunks = [state, &func, n, n_chunks, chunk_size]() {
+        size_t n_done = 0;
+        for (size_t chunk; (chunk = state->next++) < n_chunks; ++n_done) {
+            const size_t begin = chunk * chunk_size;
+            func(begin, std::min(begin + chunk_size, n));
+        }
+        if (n_done) {
+            std::lock_guard<std::mutex> lock(state->mtx);
+            state->done += n_done;
+            if (state->done == n_chunks) state->cv.notify_all();
+        }
+    };
+    for (size_t i = 1; i < n_threads; ++i) {
+        // Helpers only touch func while chunks remain, i.e. before we return
+        push(run_chunks);
+    }
+    run_chunks();
+    std::unique_lock<std::mutex> lock(state->mtx);
+    state->cv.wait(lock, [&] { return state->done == n_chunks; });
+}
+
+ThreadPool& ThreadPool::global() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::_worker_loop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(_mtx);
+            _cv.wait(lock, [this] { return _stop || !_tasks.empty(); });
+            if (_stop && _tasks.empty()) return;
+            task = std::move(_tasks.front());
+            _tasks.pop_front();
+        }
+        task();
+    }
+}
+
+}  // namespace smplx
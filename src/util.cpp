@@ -25,6 +25,35 @@ Gender parse_gender(std::string str) {
     return Gender::unknown;
 }
 
+const char* backend_to_str(Backend backend) {
+    switch (backend) {
+        case Backend::cpu_reference: return "cpu_reference";
+        case Backend::cpu_simd: return "cpu_simd";
+        case Backend::cpu_parallel: return "cpu_parallel";
+        case Backend::cuda: return "cuda";
+        default: return "automatic";
+    }
+}
+
+Backend parse_backend(std::string str) {
+    for (auto& c : str) c = std::tolower(c);
+    if (str == "cpu_reference") return Backend::cpu_reference;
+    if (str == "cpu_simd" || str == "cpu") return Backend::cpu_simd;
+    if (str == "cpu_parallel") return Backend::cpu_parallel;
+    if (str == "cuda" || str == "gpu") return Backend::cuda;
+    if (str != "automatic")
+        std::cerr << "WARNING: Backend '" << str << "' could not be parsed\n";
+    return Backend::automatic;
+}
+
+bool backend_available(Backend backend) {
+#ifdef SMPLX_CUDA_ENABLED
+    return true;
+#else
+    return backend != Backend::cuda;
+#endif
+}
+
 std::string find_data_file(const std::string& data_path) {
     static const std::string TEST_PATH = "data/models/smplx/uv.txt";
     static const int MAX_LEVELS = 3;
@@ -0,0 +1,253 @@
+#include "smplx/internal/uv_map.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <sys/stat.h>
+
+namespace smplx {
+namespace internal {
+
+namespace {
+static_assert(sizeof(Scalar) == 4 && sizeof(Index) == 4,
+              ".smplxuv stores float coordinates and uint32 indices");
+
+const double POW10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                        1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                        1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+inline bool is_space(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+// Reads whitespace-separated numbers from a null-terminated buffer, with
+// no locale or stream state; each read returns false on a malformed token
+class Scanner {
+   public:
+    explicit Scanner(const char* text) : _p(text) {}
+
+    bool next_uint(uint64_t& out) {
+        _skip_space();
+        if (!is_digit(*_p)) return false;
+        out = 0;
+        for (; is_digit(*_p); ++_p) {
+            if (out > UINT32_MAX) return false;
+            out = out * 10 + (*_p - '0');
+        }
+        return _at_end_of_token();
+    }
+
+    bool next_float(Scalar& out) {
+        _skip_space();
+        const bool negative = *_p == '-';
+        if (*_p == '-' || *_p == '+') ++_p;
+        // value = mantissa * 10^exp10, keeping the first 19 digits
+        const uint64_t MAX_MANTISSA = 999999999999999999ULL;
+        uint64_t mantissa = 0;
+        int exp10 = 0;
+        bool any_digits = false;
+        for (; is_digit(*_p); ++_p, any_digits = true) {
+            if (mantissa <= MAX_MANTISSA) {
+                mantissa = mantissa * 10 + (*_p - '0');
+            } else {
+                ++exp10;
+            }
+        }
+        if (*_p == '.') {
+            for (++_p; is_digit(*_p); ++_p, any_digits = true) {
+                if (mantissa <= MAX_MANTISSA) {
+                    mantissa = mantissa * 10 + (*_p - '0');
+                    --exp10;
+                }
+            }
+        }
+        if (!any_digits) return false;
+        if (*_p == 'e' || *_p == 'E') {
+            ++_p;
+            const bool negative_exp = *_p == '-';
+            if (*_p == '-' || *_p == '+') ++_p;
+            if (!is_digit(*_p)) return false;
+            int exp = 0;
+            for (; is_digit(*_p); ++_p) {
+                if (exp < 1000) exp = exp * 10 + (*_p - '0');
+            }
+            exp10 += negative_exp ? -exp : exp;
+        }
+        double value = (double)mantissa;
+        if (mantissa < (1ULL << 53) && exp10 >= -22 && exp10 <= 22) {
+            // Exact operands, so correctly rounded
+            value = exp10 < 0 ? value / POW10[-exp10] : value * POW10[exp10];
+        } else if (mantissa) {
+            value *= std::pow(10.0, exp10);
+        }
+        out = (Scalar)(negative ? -value : value);
+        return _at_end_of_token();
+    }
+
+   private:
+    void _skip_space() {
+        while (is_space(*_p)) ++_p;
+    }
+    bool _at_end_of_token() const { return !*_p || is_space(*_p); }
+
+    const char* _p;
+};
+
+std::runtime_error invalid_uv_map(const std::string& path) {
+    return std::runtime_error("Invalid UV map '" + path + "'");
+}
+
+// Size and modification time (in ns where available, else s) of the file
+// at path; false if it cannot be read
+bool stat_file(const std::string& path, uint64_t& size, int64_t& mtime) {
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) return false;
+    size = (uint64_t)st.st_size;
+#if defined(__APPLE__)
+    mtime = (int64_t)st.st_mtimespec.tv_sec * 1000000000 +
+            st.st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+    mtime = (int64_t)st.st_mtime;
+#else
+    mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    return true;
+}
+
+// Load the cache at cache_path if made from a text file of source_size
+// and source_mtime, with n_faces triangles; false if it is stale or
+// unreadable
+bool read_uv_cache(const std::string& cache_path, size_t n_faces,
+                   uint64_t source_size, int64_t source_mtime, Points2D& uv,
+                   Triangles& uv_faces) {
+    std::ifstream ifs(cache_path, std::ios::binary | std::ios::ate);
+    if (!ifs) return false;
+    const uint64_t file_size = (uint64_t)ifs.tellg();
+    ifs.seekg(0);
+    uvbin::Header header;
+    if (!ifs.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, uvbin::MAGIC, sizeof(uvbin::MAGIC)) ||
+        header.version != uvbin::VERSION || header.n_faces != n_faces ||
+        header.source_size != source_size ||
+        header.source_mtime != source_mtime) {
+        return false;
+    }
+    // Before allocating what a corrupt header may claim
+    if (file_size != sizeof(header) +
+                         (uint64_t)header.n_uv_verts * 2 * sizeof(Scalar) +
+                         (uint64_t)n_faces * 3 * sizeof(Index)) {
+        return false;
+    }
+    Points2D new_uv(header.n_uv_verts, 2);
+    Triangles new_uv_faces(n_faces, 3);
+    ifs.read(reinterpret_cast<char*>(new_uv.data()),
+             new_uv.size() * sizeof(Scalar));
+    ifs.read(reinterpret_cast<char*>(new_uv_faces.data()),
+             new_uv_faces.size() * sizeof(Index));
+    if (!ifs || (n_faces && new_uv_faces.maxCoeff() >= header.n_uv_verts)) {
+        return false;
+    }
+    uv = std::move(new_uv);
+    uv_faces = std::move(new_uv_faces);
+    return true;
+}
+
+// Write the cache of a text file of source_size and source_mtime; written
+// aside and renamed over, so readers never see it partly written
+void write_uv_cache(const std::string& cache_path, uint64_t source_size,
+                    int64_t source_mtime, const Points2D& uv,
+                    const Triangles& uv_faces) {
+    uvbin::Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, uvbin::MAGIC, sizeof(uvbin::MAGIC));
+    header.version = uvbin::VERSION;
+    header.n_uv_verts = (uint32_t)uv.rows();
+    header.n_faces = uv_faces.rows();
+    header.source_size = source_size;
+    header.source_mtime = source_mtime;
+
+    const std::string tmp_path = cache_path + ".tmp";
+    {
+        std::ofstream ofs(tmp_path, std::ios::binary);
+        ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        ofs.write(reinterpret_cast<const char*>(uv.data()),
+                  uv.size() * sizeof(Scalar));
+        ofs.write(reinterpret_cast<const char*>(uv_faces.data()),
+                  uv_faces.size() * sizeof(Index));
+        if (!ofs) {
+            ofs.close();
+            std::remove(tmp_path.c_str());
+            return;
+        }
+    }
+#ifdef _WIN32
+    // rename does not replace files on Windows
+    std::remove(cache_path.c_str());
+#endif
+    if (std::rename(tmp_path.c_str(), cache_path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+    }
+}
+}  // namespace
+
+std::string uv_cache_path(const std::string& path) {
+    const size_t dot = path.rfind('.');
+    const size_t slash = path.find_last_of("/\\");
+    if (dot == std::string::npos ||
+        (slash != std::string::npos && dot < slash)) {
+        return path + ".smplxuv";
+    }
+    return path.substr(0, dot) + ".smplxuv";
+}
+
+void parse_uv_text(const std::string& path, size_t n_faces, Points2D& uv,
+                   Triangles& uv_faces) {
+    std::ifstream ifs(path, std::ios::binary | std::ios::ate);
+    if (!ifs) throw std::runtime_error("Cannot open '" + path + "'");
+    std::string text((size_t)ifs.tellg(), '\0');
+    ifs.seekg(0);
+    if (!ifs.read(&text[0], text.size())) {
+        throw std::runtime_error("Cannot read '" + path + "'");
+    }
+
+    Scanner scanner(text.c_str());
+    uint64_t n_uv_verts;
+    if (!scanner.next_uint(n_uv_verts)) throw invalid_uv_map(path);
+    Points2D new_uv(n_uv_verts, 2);
+    Scalar* uv_data = new_uv.data();
+    for (size_t i = 0; i < 2 * n_uv_verts; ++i) {
+        if (!scanner.next_float(uv_data[i])) throw invalid_uv_map(path);
+    }
+    Triangles new_uv_faces(n_faces, 3);
+    Index* faces_data = new_uv_faces.data();
+    for (size_t i = 0; i < 3 * n_faces; ++i) {
+        uint64_t index;
+        if (!scanner.next_uint(index) || index == 0 || index > n_uv_verts) {
+            throw invalid_uv_map(path);
+        }
+        // Make indices 0-based
+        faces_data[i] = (Index)(index - 1);
+    }
+    uv = std::move(new_uv);
+    uv_faces = std::move(new_uv_faces);
+}
+
+void load_uv_map(const std::string& path, size_t n_faces, Points2D& uv,
+                 Triangles& uv_faces) {
+    uint64_t source_size;
+    int64_t source_mtime;
+    if (!stat_file(path, source_size, source_mtime)) {
+        throw std::runtime_error("Cannot open '" + path + "'");
+    }
+    const std::string cache_path = uv_cache_path(path);
+    if (read_uv_cache(cache_path, n_faces, source_size, source_mtime, uv,
+                      uv_faces)) {
+        return;
+    }
+    parse_uv_text(path, n_faces, uv, uv_faces);
+    write_uv_cache(cache_path, source_size, source_mtime, uv, uv_faces);
+}
+
+}  // namespace internal
+}  // namespace smplx
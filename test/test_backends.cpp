@@ -0,0 +1,101 @@
+// Backend conformance test: every available backend must match
+// cpu_reference on the same random parameters, for each model config with
+// a model in data/ (see SMPLX_DIR). Exits 77 (skipped) if there is none.
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "smplx/smplx.hpp"
+#include "smplx/util.hpp"
+
+namespace {
+using namespace smplx;
+
+const Scalar TOLERANCE = 1e-4f;
+const int N_TRIALS = 4;
+
+bool model_exists(const std::string& prefix) {
+    return std::ifstream(prefix + ".npz").good() ||
+           std::ifstream(prefix + ".smplxbin").good();
+}
+
+template <class Matrix>
+Scalar max_abs_diff(const Matrix& a, const Matrix& b) {
+    if (a.rows() != b.rows() || a.cols() != b.cols()) return INFINITY;
+    return (a - b).cwiseAbs().maxCoeff();
+}
+
+// Returns the number of failed checks, or -1 if no model was found
+template <class ModelConfig>
+int check_config() {
+    const Gender GENDERS[] = {Gender::neutral, Gender::male, Gender::female};
+    for (Gender gender : GENDERS) {
+        const std::string prefix = util::find_data_file(
+            std::string(ModelConfig::default_path_prefix) +
+            util::gender_to_str(gender));
+        if (!model_exists(prefix)) continue;
+
+        Model<ModelConfig> model(gender);
+        if (model.verts.rows() == 0) return 1;
+        std::cout << ModelConfig::model_name << " "
+                  << util::gender_to_str(gender) << "\n";
+
+        const Backend BACKENDS[] = {Backend::cpu_simd, Backend::cpu_parallel,
+                                    Backend::cuda};
+        std::mt19937 rng(1234);
+        std::uniform_real_distribution<Scalar> uniform(-1.f, 1.f);
+        int failures = 0;
+        for (int trial = 0; trial < N_TRIALS; ++trial) {
+            Body<ModelConfig> body(model);
+            for (Eigen::Index i = 0; i < body.params.size(); ++i) {
+                body.params[i] = uniform(rng);
+            }
+            // Alternate pose blend shapes, which take a separate path
+            const bool pose_blendshapes = trial % 2 == 0;
+            body.set_backend(Backend::cpu_reference);
+            body.update(false, pose_blendshapes);
+            const Points ref_verts = body.verts();
+            const Points ref_joints = body.joints();
+
+            for (Backend backend : BACKENDS) {
+                if (!util::backend_available(backend)) continue;
+                body.set_backend(backend);
+                body.update(false, pose_blendshapes);
+                const Scalar verts_diff = max_abs_diff(body.verts(), ref_verts);
+                const Scalar joints_diff =
+                    max_abs_diff(body.joints(), ref_joints);
+                if (!(verts_diff <= TOLERANCE && joints_diff <= TOLERANCE)) {
+                    std::cout << "  FAIL " << util::backend_to_str(backend)
+                              << " trial " << trial
+                              << ": verts diff " << verts_diff
+                              << ", joints diff " << joints_diff << "\n";
+                    ++failures;
+                }
+            }
+        }
+        return failures;
+    }
+    return -1;
+}
+}  // namespace
+
+int main() {
+    int results[] = {check_config<model_config::SMPL>(),
+                     check_config<model_config::SMPLH>(),
+                     check_config<model_config::SMPLX>()};
+    int failures = 0;
+    bool any_model = false;
+    for (int result : results) {
+        if (result < 0) continue;
+        any_model = true;
+        failures += result;
+    }
+    if (!any_model) {
+        std::cout << "No models found, see data/models/README.md\n";
+        return 77;
+    }
+    std::cout << (failures ? "FAILED" : "PASSED") << "\n";
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,67 @@
+// Memory locking test: data pinned by Model::warmup(true) must stay pinned
+// when set_shape_space or set_huge_pages move the blend shapes, and be
+// unpinned when the model is destroyed. Reads the locked size from
+// /proc/self/status (Linux); exits 77 (skipped) without it, without an
+// SMPL model in data/ (see SMPLX_DIR) or if pages cannot be locked.
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "smplx/smplx.hpp"
+#include "smplx/util.hpp"
+
+namespace {
+using namespace smplx;
+
+// Locked bytes of this process; -1 if unknown
+long long locked_bytes() {
+    std::ifstream ifs("/proc/self/status");
+    std::string line;
+    while (std::getline(ifs, line)) {
+        if (line.compare(0, 6, "VmLck:") == 0) {
+            return std::stoll(line.substr(6)) * 1024;
+        }
+    }
+    return -1;
+}
+}  // namespace
+
+int main() {
+    const std::string path =
+        util::find_data_file("models/smpl/SMPL_NEUTRAL.npz");
+    const long long before = locked_bytes();
+    if (before < 0 || !std::ifstream(path)) {
+        std::cout << "No VmLck or SMPL model, skipping\n";
+        return 77;
+    }
+
+    int failures = 0;
+    auto check = [&](bool ok, const std::string& what) {
+        std::cout << (ok ? "ok   " : "FAIL ") << what << ": "
+                  << locked_bytes() - before << " bytes locked\n";
+        if (!ok) ++failures;
+    };
+    {
+        ModelS model(path, "", Gender::neutral);
+        model.warmup(true);
+        const long long blend_bytes = util::dense_bytes(model.blend_shapes);
+        if (locked_bytes() - before < blend_bytes) {
+            std::cout << "Cannot lock pages (ulimit -l), skipping\n";
+            return 77;
+        }
+        check(true, "warmup");
+
+        model.set_shape_space(2, 0);
+        check(locked_bytes() - before >=
+                  (long long)util::dense_bytes(model.blend_shapes),
+              "set_shape_space");
+
+        model.set_huge_pages(HugePages::off);
+        check(locked_bytes() - before >=
+                  (long long)util::dense_bytes(model.blend_shapes),
+              "set_huge_pages");
+    }
+    check(locked_bytes() == before, "destroyed");
+    std::cout << (failures ? "FAILED" : "PASSED") << "\n";
+    return failures ? 1 : 0;
+}